@@ -0,0 +1,665 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* known answer tests and throughput of libpiano's hot paths, built by
+ * `make bench`; exits non-zero if a check fails */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "piano.h"
+#include "crypt.h"
+#include "hex.h"
+
+/* contrib/hex_scalar.c */
+void PianoHexEncodeScalar (char * const, const unsigned char * const,
+		const size_t);
+bool PianoHexDecodeScalar (unsigned char * const, const char * const,
+		const size_t);
+
+static unsigned int failures = 0;
+
+#define check(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			printf ("FAIL %s:%d: ", __FILE__, __LINE__); \
+			printf (__VA_ARGS__); \
+			printf ("\n"); \
+			++failures; \
+		} \
+	} while (0)
+
+/*	seconds since some point in the past
+ */
+static double BenchNow () {
+	return (double) clock () / CLOCKS_PER_SEC;
+}
+
+/*	print throughput of a loop
+ *	@param label
+ *	@param bytes processed per iteration
+ *	@param iterations done
+ *	@param seconds taken
+ */
+static void BenchReport (const char *label, size_t bytes, size_t iterations,
+		double seconds) {
+	if (seconds <= 0) {
+		seconds = 1e-9;
+	}
+	printf ("  %-32s %8.1f MB/s %10.1f ns/op\n", label,
+			(double) bytes * iterations / seconds / 1e6,
+			seconds / iterations * 1e9);
+}
+
+/*	parse hex string written by hand, no validation
+ */
+static void BenchFromHex (unsigned char *out, const char *hex, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		unsigned int byte;
+		sscanf (&hex[i*2], "%2x", &byte);
+		out[i] = (unsigned char) byte;
+	}
+}
+
+/*	blowfish: known answers (Eric Young's ecb vectors), round trips and
+ *	throughput with one block, one four block kernel run and many blocks
+ */
+static void BenchCipher () {
+	static const char * const vectors[][3] = {
+		/* key, plaintext, ciphertext */
+		{"0000000000000000", "0000000000000000", "4ef997456198dd78"},
+		{"ffffffffffffffff", "ffffffffffffffff", "51866fd5b85ecb8a"},
+		{"3000000000000000", "1000000000000001", "7d856f9a613063f2"},
+		{"1111111111111111", "1111111111111111", "2466dd878b963c9d"},
+		{"0123456789abcdef", "1111111111111111", "61f9c3802281b096"},
+		{"fedcba9876543210", "0123456789abcdef", "0aceab0fc6a0a28d"},
+		{"7ca110454a1a6e57", "01a1d6d039776742", "59c68245eb05282b"},
+		{"0131d9619dc1376e", "5cd54ca83def57da", "b1b8cc0b250f09a0"},
+	};
+	const size_t vectorCount = sizeof (vectors) / sizeof (*vectors);
+	static const size_t sizes[] = {8, 4*8, 64*1024};
+	PianoCipher_t cipher;
+
+	printf ("cipher\n");
+
+	for (size_t t = 0; t < vectorCount; t++) {
+		unsigned char key[8], plain[8], decrypted[8];
+		char hex[17];
+
+		BenchFromHex (key, vectors[t][0], sizeof (key));
+		BenchFromHex (plain, vectors[t][1], sizeof (plain));
+
+		check (PianoCryptInit (&cipher, (const char *) key, sizeof (key)) ==
+				PIANO_RET_OK, "init %zu", t);
+		check (PianoEncryptHexSize (sizeof (plain)) == sizeof (hex),
+				"hex size");
+		PianoEncryptHex (cipher, (const char *) plain, sizeof (plain), hex);
+		check (strcmp (hex, vectors[t][2]) == 0, "encrypt %zu: %s", t, hex);
+		check (PianoDecryptHex (cipher, vectors[t][2], 16, decrypted) &&
+				memcmp (decrypted, plain, sizeof (plain)) == 0,
+				"decrypt %zu", t);
+		PianoCryptDestroy (cipher);
+	}
+
+	/* every length up to a few kernel runs, the four block kernel and the
+	 * single block tail must agree */
+	check (PianoCryptInit (&cipher, "R=U!LH$O2B#", 11) == PIANO_RET_OK,
+			"init");
+	for (size_t size = 0; size <= 100; size++) {
+		char plain[101], *hex, *single;
+		unsigned char *decrypted;
+		const size_t hexSize = PianoEncryptHexSize (size);
+
+		for (size_t i = 0; i < size; i++) {
+			plain[i] = (char) ('!' + (i * 7 + size) % 90);
+		}
+		hex = malloc (hexSize);
+		single = malloc (hexSize);
+		decrypted = malloc (hexSize / 2);
+
+		PianoEncryptHex (cipher, plain, size, hex);
+		for (size_t i = 0; i < size; i += 8) {
+			PianoEncryptHex (cipher, &plain[i], size - i < 8 ? size - i : 8,
+					&single[i*2]);
+		}
+		if (size == 0) {
+			single[0] = '\0';
+		}
+		check (strlen (hex) == hexSize - 1, "length %zu", size);
+		check (strcmp (hex, single) == 0, "lanes %zu", size);
+		check (PianoDecryptHex (cipher, hex, hexSize - 1, decrypted) &&
+				memcmp (decrypted, plain, size) == 0,
+				"round trip %zu", size);
+		for (size_t i = size; i < (hexSize - 1) / 2; i++) {
+			check (decrypted[i] == '\0', "padding %zu", size);
+		}
+
+		free (hex);
+		free (single);
+		free (decrypted);
+	}
+	check (!PianoDecryptHex (cipher, "0123456789abcdeg", 16,
+			(unsigned char[8]) {0}), "invalid digit accepted");
+	check (!PianoDecryptHex (cipher, "0123456789abcd", 14,
+			(unsigned char[7]) {0}), "partial block accepted");
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (*sizes); s++) {
+		const size_t size = sizes[s];
+		const size_t iterations = (16*1024*1024) / size;
+		char *plain = calloc (size, 1), *hex = malloc (size*2+1);
+		unsigned char *decrypted = malloc (size);
+		char label[64];
+		double started;
+
+		memset (plain, 'a', size);
+
+		started = BenchNow ();
+		for (size_t i = 0; i < iterations; i++) {
+			PianoEncryptHex (cipher, plain, size, hex);
+		}
+		snprintf (label, sizeof (label), "encrypt+hex %zu blocks", size / 8);
+		BenchReport (label, size, iterations, BenchNow () - started);
+
+		started = BenchNow ();
+		for (size_t i = 0; i < iterations; i++) {
+			PianoDecryptHex (cipher, hex, size*2, decrypted);
+		}
+		snprintf (label, sizeof (label), "hex+decrypt %zu blocks", size / 8);
+		BenchReport (label, size, iterations, BenchNow () - started);
+		check (memcmp (decrypted, plain, size) == 0, "bulk %zu", size);
+
+		free (plain);
+		free (hex);
+		free (decrypted);
+	}
+
+	PianoCryptDestroy (cipher);
+}
+
+/*	hex encoder libpiano used before hex.c
+ */
+static void BenchHexEncodeSnprintf (char *out, const unsigned char *in,
+		size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		snprintf (&out[i*2], 3, "%02x", in[i]);
+	}
+}
+
+/*	hex decoder libpiano used before hex.c, does not validate
+ */
+static bool BenchHexDecodeStrtol (unsigned char *out, const char *in,
+		size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		char hex[3];
+		memcpy (hex, &in[i*2], 2);
+		hex[2] = '\0';
+		out[i] = (unsigned char) strtol (hex, NULL, 16);
+	}
+	return true;
+}
+
+/*	hex codec: dispatching (SSE2 where available) and table code agree with
+ *	the old snprintf/strtol code on every length around the vector width,
+ *	then throughput of all three
+ */
+static void BenchHex () {
+	typedef void (*encoder) (char * const, const unsigned char * const,
+			const size_t);
+	typedef bool (*decoder) (unsigned char * const, const char * const,
+			const size_t);
+	static const struct {
+		const char *name;
+		encoder encode;
+		decoder decode;
+	} codecs[] = {
+		{"dispatch", PianoHexEncode, PianoHexDecode},
+		{"scalar", PianoHexEncodeScalar, PianoHexDecodeScalar},
+		{"snprintf/strtol", BenchHexEncodeSnprintf, BenchHexDecodeStrtol},
+	};
+	const size_t codecCount = sizeof (codecs) / sizeof (*codecs);
+	static const size_t sizes[] = {16, 1024, 64*1024};
+	unsigned char in[100], decoded[100];
+	char expected[201], out[201];
+
+	printf ("hex\n");
+
+	for (size_t i = 0; i < sizeof (in); i++) {
+		in[i] = (unsigned char) (i * 37 + 11);
+	}
+
+	for (size_t size = 0; size <= sizeof (in); size++) {
+		BenchHexEncodeSnprintf (expected, in, size);
+		expected[size*2] = '\0';
+
+		for (size_t c = 0; c < 2; c++) {
+			memset (out, 0, sizeof (out));
+			codecs[c].encode (out, in, size);
+			check (strcmp (out, expected) == 0, "%s encode %zu",
+					codecs[c].name, size);
+
+			memset (decoded, 0, sizeof (decoded));
+			check (codecs[c].decode (decoded, expected, size) &&
+					memcmp (decoded, in, size) == 0, "%s decode %zu",
+					codecs[c].name, size);
+
+			/* uppercase digits are accepted as well */
+			for (size_t i = 0; i < size*2; i++) {
+				if (out[i] >= 'a' && out[i] <= 'f') {
+					out[i] = (char) (out[i] - 'a' + 'A');
+				}
+			}
+			memset (decoded, 0, sizeof (decoded));
+			check (codecs[c].decode (decoded, out, size) &&
+					memcmp (decoded, in, size) == 0, "%s uppercase %zu",
+					codecs[c].name, size);
+
+			/* a bad digit anywhere is found, by the kernel or the tail */
+			for (size_t i = 0; i < size*2; i++) {
+				static const char bad[] = "g/:@`G \xff";
+				const char keep = out[i];
+
+				out[i] = bad[i % (sizeof (bad) - 1)];
+				check (!codecs[c].decode (decoded, out, size),
+						"%s bad digit %zu/%zu", codecs[c].name, i, size);
+				out[i] = keep;
+			}
+		}
+	}
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (*sizes); s++) {
+		const size_t size = sizes[s];
+		const size_t iterations = (64*1024*1024) / size;
+		unsigned char *data = malloc (size), *back = malloc (size);
+		/* snprintf writes a NUL after the last digit */
+		char *hex = malloc (size*2+1);
+
+		for (size_t i = 0; i < size; i++) {
+			data[i] = (unsigned char) (i * 131 + 7);
+		}
+
+		for (size_t c = 0; c < codecCount; c++) {
+			/* the old code is far slower, keep its runs short */
+			const size_t n = c == codecCount-1 ? iterations / 16 : iterations;
+			char label[64];
+			double started;
+
+			started = BenchNow ();
+			for (size_t i = 0; i < n; i++) {
+				codecs[c].encode (hex, data, size);
+			}
+			snprintf (label, sizeof (label), "encode %s %zu bytes",
+					codecs[c].name, size);
+			BenchReport (label, size, n, BenchNow () - started);
+
+			started = BenchNow ();
+			for (size_t i = 0; i < n; i++) {
+				codecs[c].decode (back, hex, size);
+			}
+			snprintf (label, sizeof (label), "decode %s %zu bytes",
+					codecs[c].name, size);
+			BenchReport (label, size, n, BenchNow () - started);
+			check (memcmp (back, data, size) == 0, "%s bulk %zu",
+					codecs[c].name, size);
+		}
+
+		free (data);
+		free (back);
+		free (hex);
+	}
+}
+
+/*	station list of given size, every third station is part of the mix
+ *	@return json body, to be freed
+ */
+static char *BenchStationList (size_t stations) {
+	/* a station takes less than 100 bytes, an id in the mix 12 */
+	const size_t size = 256 + stations * 112;
+	char *body = malloc (size), *pos = body;
+
+	pos += sprintf (pos, "{\"stat\":\"ok\",\"result\":{\"stations\":[");
+	for (size_t i = 0; i < stations; i++) {
+		pos += sprintf (pos, "{\"stationName\":\"Station %zu\","
+				"\"stationToken\":\"%zu\",\"isQuickMix\":false},", i,
+				1000000 + i);
+	}
+	pos += sprintf (pos, "{\"stationName\":\"QuickMix\","
+			"\"stationToken\":\"1\",\"isQuickMix\":true,"
+			"\"quickMixStationIds\":[");
+	for (size_t i = 0; i < stations; i += 3) {
+		pos += sprintf (pos, "%s\"%zu\"", i > 0 ? "," : "", 1000000 + i);
+	}
+	strcpy (pos, "]}]}}");
+
+	return body;
+}
+
+/*	QuickMix flags: parse station lists of growing size, check the flags and
+ *	compare the time spent with the pairwise comparison used before the
+ *	station index, run on the parsed list
+ */
+static void BenchQuickMix () {
+	static const size_t sizes[] = {100, 1000, 10000};
+
+	printf ("quickmix\n");
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (*sizes); s++) {
+		const size_t stations = sizes[s];
+		const size_t repeat = 20000 / stations + 1;
+		char * const body = BenchStationList (stations);
+		double parsing = 0, pairwise = 0;
+		char label[64];
+
+		for (size_t r = 0; r < repeat; r++) {
+			PianoHandle_t ph;
+			PianoRequest_t req;
+			const PianoStation_t *station;
+			char **mix;
+			size_t mixSize = 0, flagged = 0;
+			double started;
+
+			PianoInit (&ph, "user", "password", "device", "key", "key");
+			memset (&req, 0, sizeof (req));
+			req.type = PIANO_REQUEST_GET_STATIONS;
+			req.responseData = body;
+			req.responseDataSize = strlen (body);
+
+			started = BenchNow ();
+			check (PianoResponse (&ph, &req) == PIANO_RET_OK, "response");
+			parsing += BenchNow () - started;
+			req.responseData = NULL;
+			PianoDestroyRequest (&req);
+
+			/* ids copied out of the response, the way the old loop saw
+			 * them */
+			mix = malloc ((stations / 3 + 1) * sizeof (*mix));
+			for (size_t i = 0; i < stations; i += 3) {
+				mix[mixSize] = malloc (24);
+				snprintf (mix[mixSize++], 24, "%zu", 1000000 + i);
+			}
+
+			station = ph.stations;
+			PianoListForeachP (station) {
+				const bool expected = !station->isQuickMix &&
+						(strtoul (station->id, NULL, 10) - 1000000) % 3 == 0;
+				check (station->useQuickMix == expected, "flag of %s",
+						station->id);
+				flagged += station->useQuickMix;
+			}
+			check (flagged == mixSize, "%zu flagged, %zu in mix", flagged,
+					mixSize);
+
+			started = BenchNow ();
+			station = ph.stations;
+			flagged = 0;
+			PianoListForeachP (station) {
+				for (size_t i = 0; i < mixSize; i++) {
+					if (strcmp (mix[i], station->id) == 0) {
+						++flagged;
+					}
+				}
+			}
+			pairwise += BenchNow () - started;
+			check (flagged == mixSize, "pairwise found %zu", flagged);
+
+			for (size_t i = 0; i < mixSize; i++) {
+				free (mix[i]);
+			}
+			free (mix);
+			PianoDestroy (&ph);
+		}
+
+		snprintf (label, sizeof (label), "parse %zu stations", stations);
+		BenchReport (label, strlen (body), repeat, parsing);
+		snprintf (label, sizeof (label), "pairwise flags %zu stations",
+				stations);
+		BenchReport (label, strlen (body), repeat, pairwise);
+
+		free (body);
+	}
+}
+
+/*	feed body to request in chunks, the way the http layer does
+ *	@param request
+ *	@param body
+ *	@param chunk size, 0 for none at all
+ */
+static void BenchFeed (PianoRequest_t *req, char *body, size_t chunk) {
+	const size_t size = strlen (body);
+
+	req->responseData = body;
+	req->responseDataSize = size;
+	for (size_t i = 0; chunk > 0 && i < size; i += chunk) {
+		PianoResponseFeed (req, body + i, size - i < chunk ? size - i : chunk);
+	}
+}
+
+static bool BenchSame (const char *a, const char *b) {
+	return a == b || (a != NULL && b != NULL && strcmp (a, b) == 0);
+}
+
+/*	station list read from the chunks must equal the one parsed afterwards
+ */
+static void BenchStreamStations (const char *name, const char *json,
+		const size_t chunk) {
+	PianoHandle_t expected, actual;
+	PianoRequest_t req;
+	char * const body = strdup (json);
+	PianoReturn_t ret[2];
+
+	PianoInit (&expected, "user", "password", "device", "key", "key");
+	PianoInit (&actual, "user", "password", "device", "key", "key");
+
+	memset (&req, 0, sizeof (req));
+	req.type = PIANO_REQUEST_GET_STATIONS;
+	BenchFeed (&req, body, 0);
+	ret[0] = PianoResponse (&expected, &req);
+	PianoDestroyRequest (&req);
+
+	memset (&req, 0, sizeof (req));
+	req.type = PIANO_REQUEST_GET_STATIONS;
+	BenchFeed (&req, body, chunk);
+	ret[1] = PianoResponse (&actual, &req);
+	PianoDestroyRequest (&req);
+
+	check (ret[0] == ret[1], "%s/%zu: returned %d, not %d", name, chunk,
+			ret[1], ret[0]);
+	const PianoStation_t *a = expected.stations, *b = actual.stations;
+	while (a != NULL && b != NULL) {
+		check (BenchSame (a->name, b->name) && BenchSame (a->id, b->id) &&
+				a->isCreator == b->isCreator &&
+				a->isQuickMix == b->isQuickMix &&
+				a->useQuickMix == b->useQuickMix, "%s/%zu: station %s", name,
+				chunk, a->id);
+		check (b->id == NULL || PianoGetStationById (&actual,
+				b->id) == b, "%s/%zu: index of %s", name, chunk, b->id);
+		a = (const PianoStation_t *) a->head.next;
+		b = (const PianoStation_t *) b->head.next;
+	}
+	check (a == NULL && b == NULL, "%s/%zu: station count", name, chunk);
+
+	PianoDestroy (&expected);
+	PianoDestroy (&actual);
+	free (body);
+}
+
+static void BenchCompareSongs (const char *name, const size_t chunk,
+		const PianoSong_t *a, const PianoSong_t *b) {
+	while (a != NULL && b != NULL) {
+		check (BenchSame (a->title, b->title) &&
+				BenchSame (a->artist, b->artist) &&
+				BenchSame (a->seedId, b->seedId) &&
+				BenchSame (a->feedbackId, b->feedbackId) &&
+				a->rating == b->rating && a->length == b->length,
+				"%s/%zu: song %s", name, chunk, a->title);
+		a = (const PianoSong_t *) a->head.next;
+		b = (const PianoSong_t *) b->head.next;
+	}
+	check (a == NULL && b == NULL, "%s/%zu: song count", name, chunk);
+}
+
+/*	same for station info
+ */
+static void BenchStreamStationInfo (const char *name, const char *json,
+		const size_t chunk) {
+	PianoHandle_t ph;
+	PianoRequest_t req;
+	PianoRequestDataGetStationInfo_t data[2];
+	char * const body = strdup (json);
+	PianoReturn_t ret[2];
+
+	PianoInit (&ph, "user", "password", "device", "key", "key");
+	memset (data, 0, sizeof (data));
+
+	for (size_t i = 0; i < 2; i++) {
+		memset (&req, 0, sizeof (req));
+		req.type = PIANO_REQUEST_GET_STATION_INFO;
+		req.data = &data[i];
+		BenchFeed (&req, body, i == 0 ? 0 : chunk);
+		ret[i] = PianoResponse (&ph, &req);
+		PianoDestroyRequest (&req);
+	}
+
+	check (ret[0] == ret[1], "%s/%zu: returned %d, not %d", name, chunk,
+			ret[1], ret[0]);
+	BenchCompareSongs (name, chunk, data[0].info.songSeeds,
+			data[1].info.songSeeds);
+	BenchCompareSongs (name, chunk, data[0].info.feedback,
+			data[1].info.feedback);
+	const PianoArtist_t *a = data[0].info.artistSeeds,
+			*b = data[1].info.artistSeeds;
+	while (a != NULL && b != NULL) {
+		check (BenchSame (a->name, b->name) &&
+				BenchSame (a->seedId, b->seedId), "%s/%zu: artist %s", name,
+				chunk, a->name);
+		a = (const PianoArtist_t *) a->head.next;
+		b = (const PianoArtist_t *) b->head.next;
+	}
+	check (a == NULL && b == NULL, "%s/%zu: artist count", name, chunk);
+
+	PianoDestroyStationInfo (&data[0].info);
+	PianoDestroyStationInfo (&data[1].info);
+	PianoDestroy (&ph);
+	free (body);
+}
+
+/*	lists filled while the response arrives: compare them with the ones
+ *	parsed from the complete response, for chunks of any size, escapes,
+ *	errors and broken input; then time both
+ */
+static void BenchStream () {
+	static const char * const stations[][2] = {
+		{"escapes", "{\"result\": {\"stations\": [{\"stationName\": "
+				"\"R\\u00e9sum\\u00E9 \\ud83c\\udfb5 \\\"quoted\\\" \\\\ \\/ "
+				"\\b\\f\\n\\r\\t\", \"stationToken\": \"12\", "
+				"\"isShared\": true, \"extra\": {\"stationName\": \"no\", "
+				"\"list\": [1, 2.5e3, -0.5, null, [true, false]]}}, "
+				"{\"stationToken\": \"13\", \"stationName\": null, "
+				"\"isQuickMix\": 1}, {\"isQuickMix\": true, "
+				"\"quickMixStationIds\": [\"12\", \"14\", \"404\"], "
+				"\"stationToken\": \"1\", \"stationName\": \"QuickMix\"}, "
+				"{\"stationName\": \"\", \"stationToken\": \"14\", "
+				"\"isShared\": \"\", \"quickMixStationIds\": [\"13\"]}]}, "
+				"\"stat\": \"ok\"}"},
+		{"empty", "{\"stat\":\"ok\",\"result\":{\"stations\":[]}}"},
+		{"no stations", "{\"stat\":\"ok\",\"result\":{}}"},
+		{"error", "{\"stat\":\"fail\",\"message\":\"An unexpected error "
+				"occurred\",\"code\":1001}"},
+		{"stat last", "{\"result\":{\"stations\":[{\"stationToken\":\"2\"}]},"
+				"\"stat\":\"fail\",\"code\":0}"},
+		{"no stat", "{\"result\":{\"stations\":[{\"stationToken\":\"2\"}]}}"},
+		{"truncated", "{\"stat\":\"ok\",\"result\":{\"stations\":[{\"statio"},
+		{"broken", "{\"stat\":\"ok\",\"result\":{\"stations\":[{\"a\":tru}]}}"},
+		{"lone surrogate", "{\"stat\":\"ok\",\"result\":{\"stations\":"
+				"[{\"stationName\":\"\\udc00\"}]}}"},
+	};
+	static const char info[] =
+			"{\"stat\":\"ok\",\"result\":{\"music\":{\"songs\":["
+			"{\"songName\":\"S\\u00f6ng\",\"artistName\":\"A\","
+			"\"seedId\":\"s1\"},{\"seedId\":\"s2\",\"songName\":\"T\","
+			"\"artistName\":\"A\"}],\"artists\":[{\"artistName\":\"A\","
+			"\"seedId\":\"a1\"},{\"artistName\":\"B\",\"seedId\":null}]},"
+			"\"feedback\":{\"thumbsDown\":[{\"songName\":\"D\","
+			"\"artistName\":\"B\",\"feedbackId\":\"f1\","
+			"\"isPositive\":false,\"trackLength\":201}],"
+			"\"thumbsUp\":[{\"songName\":\"U\",\"artistName\":\"A\","
+			"\"feedbackId\":\"f2\",\"isPositive\":true,"
+			"\"trackLength\":\"180\"},{\"songName\":\"V\","
+			"\"feedbackId\":\"f3\",\"trackLength\":12.9}]}}}";
+	static const size_t chunks[] = {1, 2, 7, 64, 4096};
+	char * const large = BenchStationList (10000);
+
+	printf ("stream\n");
+
+	for (size_t c = 0; c < sizeof (chunks) / sizeof (*chunks); c++) {
+		for (size_t i = 0; i < sizeof (stations) / sizeof (*stations); i++) {
+			BenchStreamStations (stations[i][0], stations[i][1], chunks[c]);
+		}
+		BenchStreamStations ("10000 stations", large, chunks[c]);
+		BenchStreamStationInfo ("info", info, chunks[c]);
+		BenchStreamStationInfo ("info error", stations[3][1], chunks[c]);
+	}
+
+	for (size_t streamed = 0; streamed < 2; streamed++) {
+		const size_t repeat = 20;
+		double elapsed = 0;
+
+		for (size_t r = 0; r < repeat; r++) {
+			PianoHandle_t ph;
+			PianoRequest_t req;
+			double started;
+
+			PianoInit (&ph, "user", "password", "device", "key", "key");
+			memset (&req, 0, sizeof (req));
+			req.type = PIANO_REQUEST_GET_STATIONS;
+
+			/* whatever the feed costs is hidden by the download */
+			BenchFeed (&req, large, streamed ? 16384 : 0);
+			started = BenchNow ();
+			check (PianoResponse (&ph, &req) == PIANO_RET_OK, "response");
+			elapsed += BenchNow () - started;
+			PianoDestroyRequest (&req);
+			PianoDestroy (&ph);
+		}
+
+		BenchReport (streamed ? "after download, streamed" :
+				"after download, parsed", strlen (large), repeat, elapsed);
+	}
+
+	free (large);
+}
+
+int main () {
+	BenchCipher ();
+	BenchHex ();
+	BenchQuickMix ();
+	BenchStream ();
+
+	if (failures > 0) {
+		printf ("%u checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf ("all checks passed\n");
+	return EXIT_SUCCESS;
+}
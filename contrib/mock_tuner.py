@@ -0,0 +1,381 @@
+#!/usr/bin/env python3
+
+"""
+Stand-in for tuner.pandora.com, for load tests and benchmarks of pianobar's
+rpc code without touching the real service.
+
+Speaks the same /services/json/?method=... protocol, including blowfish
+encrypted request bodies and the syncTime handshake of auth.partnerLogin.
+Stations, playlists and search results are synthetic; their size and the
+latency of every response can be configured. Python 3 standard library only.
+
+Usage:
+	mock_tuner.py --port 8080 --tls-port 8443 --cert cert.pem --key key.pem
+
+or from the top directory, with the same default ports:
+	make mock-tuner MOCK_TUNER_CERT=cert.pem MOCK_TUNER_KEY=key.pem
+
+and in pianobar's config:
+	rpc_host = 127.0.0.1:8080
+	rpc_tls_port = 8443
+
+Requests marked secure (login, playlists) go to the tls port, so the
+certificate has to be trusted by the client: import it into the Windows
+certificate store for winhttp, or the system bundle for curl. Songs point
+to audio_url, which is not served here.
+"""
+
+import argparse
+import binascii
+import json
+import random
+import ssl
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlsplit, parse_qs
+
+# partner defaults of settings.c
+ENCRYPT_PASSWORD = "6#26FRL$ZWD"
+DECRYPT_PASSWORD = "R=U!LH$O2B#"
+
+# PIANO_RET_P_* - PIANO_RET_OFFSET
+CODE_INTERNAL = 0
+CODE_INVALID_AUTH_TOKEN = 1001
+CODE_INVALID_PARTNER_LOGIN = 1002
+
+
+def pi_words(count):
+	"""fractional hex digits of pi as 32 bit words, blowfish's initial
+	P-array and S-boxes; computed instead of pasting 4 KiB of constants"""
+	bits = count * 32 + 64
+	one = 1 << bits
+
+	def arctan_inv(x):
+		total = term = one // x
+		x2 = x * x
+		n = 1
+		sign = -1
+		while term:
+			term //= x2
+			total += sign * (term // (2 * n + 1))
+			sign = -sign
+			n += 1
+		return total
+
+	pi = 16 * arctan_inv(5) - 4 * arctan_inv(239)
+	fraction = (pi - 3 * one) >> 64
+	return [(fraction >> (32 * (count - 1 - i))) & 0xffffffff
+			for i in range(count)]
+
+
+_PI = pi_words(18 + 4 * 256)
+
+
+class Blowfish:
+	"""ecb only, big-endian blocks, like PianoEncryptString expects"""
+
+	def __init__(self, key):
+		key = key.encode("latin-1")
+		self.p = list(_PI[:18])
+		self.s = [list(_PI[18 + 256 * i:18 + 256 * (i + 1)]) for i in range(4)]
+
+		for i in range(18):
+			word = 0
+			for j in range(4):
+				word = (word << 8) | key[(i * 4 + j) % len(key)]
+			self.p[i] ^= word
+
+		left = right = 0
+		for i in range(0, 18, 2):
+			left, right = self._encrypt(left, right)
+			self.p[i], self.p[i + 1] = left, right
+		for box in self.s:
+			for i in range(0, 256, 2):
+				left, right = self._encrypt(left, right)
+				box[i], box[i + 1] = left, right
+
+	def _f(self, x):
+		s = self.s
+		h = (s[0][x >> 24] + s[1][(x >> 16) & 0xff]) & 0xffffffff
+		return ((h ^ s[2][(x >> 8) & 0xff]) + s[3][x & 0xff]) & 0xffffffff
+
+	def _encrypt(self, left, right):
+		p = self.p
+		for i in range(16):
+			left ^= p[i]
+			right ^= self._f(left)
+			left, right = right, left
+		left, right = right, left
+		return left ^ p[17], right ^ p[16]
+
+	def _decrypt(self, left, right):
+		p = self.p
+		for i in range(17, 1, -1):
+			left ^= p[i]
+			right ^= self._f(left)
+			left, right = right, left
+		left, right = right, left
+		return left ^ p[0], right ^ p[1]
+
+	def encrypt(self, data):
+		data += b"\0" * (-len(data) % 8)
+		out = bytearray()
+		for i in range(0, len(data), 8):
+			out += struct.pack(">II", *self._encrypt(*struct.unpack_from(">II", data, i)))
+		return bytes(out)
+
+	def decrypt(self, data):
+		out = bytearray()
+		for i in range(0, len(data) - len(data) % 8, 8):
+			out += struct.pack(">II", *self._decrypt(*struct.unpack_from(">II", data, i)))
+		return bytes(out)
+
+
+class RpcError(Exception):
+	def __init__(self, code, message):
+		Exception.__init__(self, message)
+		self.code = code
+
+
+class Catalog:
+	"""synthetic user data, deterministic for given sizes"""
+
+	def __init__(self, args):
+		self.args = args
+		self.lock = threading.Lock()
+		self.stations = [self.station("Station %d" % i, "st%d" % i)
+				for i in range(args.stations)]
+		if self.stations:
+			self.stations.append(dict(self.station("QuickMix", "qm"),
+					isQuickMix=True,
+					quickMixStationIds=[s["stationToken"] for s in self.stations[:3]]))
+		self.tracks = 0
+
+	@staticmethod
+	def station(name, token):
+		return {"stationName": name, "stationToken": token,
+				"stationId": token, "isShared": False, "isQuickMix": False}
+
+	def song(self, stationId):
+		with self.lock:
+			self.tracks += 1
+			n = self.tracks
+		url = {"audioUrl": self.args.audio_url, "encoding": "aacplus",
+				"bitrate": "64"}
+		return {"artistName": "Artist %d" % (n % 97),
+				"albumName": "Album %d" % (n % 31),
+				"songName": "Song %d" % n,
+				"trackToken": "tt%d" % n,
+				"stationId": stationId,
+				"albumArtUrl": "",
+				"songDetailUrl": "",
+				"trackGain": "0.0",
+				"trackLength": 180 + n % 120,
+				"songRating": 0,
+				"audioUrlMap": {"lowQuality": url, "mediumQuality": url,
+						"highQuality": dict(url, encoding="mp3")}}
+
+
+class Tuner:
+	def __init__(self, args):
+		self.args = args
+		self.catalog = Catalog(args)
+		self.encrypt = Blowfish(args.encrypt_password)
+		self.decrypt = Blowfish(args.decrypt_password)
+		self.partnerToken = "mock-partner-%08x" % random.getrandbits(32)
+		self.userToken = "mock-user-%08x" % random.getrandbits(32)
+
+	def body(self, method, raw):
+		if method == "auth.partnerLogin":
+			return json.loads(raw.decode("utf-8"))
+		try:
+			plain = self.encrypt.decrypt(binascii.unhexlify(raw.strip()))
+			return json.loads(plain.rstrip(b"\0").decode("utf-8"))
+		except (binascii.Error, ValueError):
+			raise RpcError(CODE_INTERNAL, "Cannot decrypt request")
+
+	def syncTime(self):
+		# client skips the first four bytes
+		plain = b"mock" + str(int(time.time())).encode("ascii")
+		return binascii.hexlify(self.decrypt.encrypt(plain)).decode("ascii")
+
+	def call(self, method, query, body):
+		if method == "auth.partnerLogin":
+			return {"partnerId": 42, "partnerAuthToken": self.partnerToken,
+					"syncTime": self.syncTime()}
+
+		if method == "auth.userLogin":
+			if body.get("partnerAuthToken") != self.partnerToken:
+				raise RpcError(CODE_INVALID_PARTNER_LOGIN, "Invalid partner login")
+			return {"userId": "mock-user", "userAuthToken": self.userToken}
+
+		if body.get("userAuthToken") != self.userToken:
+			raise RpcError(CODE_INVALID_AUTH_TOKEN, "Invalid auth token")
+
+		catalog = self.catalog
+		args = self.args
+
+		if method == "user.getStationList":
+			return {"stations": catalog.stations}
+
+		if method == "station.getPlaylist":
+			return {"items": [catalog.song(body.get("stationToken", ""))
+					for i in range(args.playlist)]}
+
+		if method == "music.search":
+			text = body.get("searchText", "")
+			return {"artists": [{"artistName": "%s artist %d" % (text, i),
+						"musicToken": "ar%d" % i, "score": 100 - i}
+						for i in range(args.search)],
+					"songs": [{"songName": "%s song %d" % (text, i),
+						"artistName": "Artist %d" % i,
+						"musicToken": "so%d" % i, "score": 100 - i}
+						for i in range(args.search)]}
+
+		if method == "station.getGenreStations":
+			return {"categories": [{"categoryName": "Genre %d" % c,
+						"stations": [{"stationName": "Genre %d station %d" % (c, i),
+							"stationToken": "ge%d_%d" % (c, i)}
+							for i in range(args.genre_stations)]}
+						for c in range(args.genres)]}
+
+		if method == "station.createStation":
+			token = "cr%d" % len(catalog.stations)
+			return catalog.station("Created %s" % body.get("musicToken", ""), token)
+
+		if method == "station.getStation":
+			return {"music": {
+						"songs": [{"songName": "Seed song %d" % i,
+							"artistName": "Artist %d" % i, "seedId": "ss%d" % i}
+							for i in range(args.seeds)],
+						"artists": [{"artistName": "Seed artist %d" % i,
+							"seedId": "sa%d" % i} for i in range(args.seeds)]},
+					"feedback": {
+						"thumbsUp": [{"songName": "Loved %d" % i,
+							"artistName": "Artist %d" % i, "feedbackId": "fu%d" % i,
+							"isPositive": True, "trackLength": 200}
+							for i in range(args.feedback)],
+						"thumbsDown": [{"songName": "Banned %d" % i,
+							"artistName": "Artist %d" % i, "feedbackId": "fd%d" % i,
+							"isPositive": False, "trackLength": 200}
+							for i in range(args.feedback)]}}
+
+		if method == "track.explainTrack":
+			return {"explanations": [{"focusTraitName": "mock trait %d" % i}
+					for i in range(3)]}
+
+		if method == "user.getSettings":
+			return {"username": "mock", "isExplicitContentFilterEnabled": False}
+
+		if method in ("interactiveradio.v1.getAvailableModesSimple",
+				"interactiveradio.v1.setAndGetAvailableModes"):
+			return {"currentModeId": body.get("modeId", 0),
+					"availableModes": [{"modeId": i, "modeName": "Mode %d" % i,
+						"modeDescription": "Mock mode %d" % i} for i in range(4)]}
+
+		# feedback, bookmarks, seeds, quickmix, ...: result is not used
+		return {}
+
+
+class Handler(BaseHTTPRequestHandler):
+	protocol_version = "HTTP/1.1"
+	server_version = "mock_tuner/1"
+
+	def log_message(self, format, *args):
+		if not self.server.tuner.args.quiet:
+			BaseHTTPRequestHandler.log_message(self, format, *args)
+
+	def do_POST(self):
+		tuner = self.server.tuner
+		args = tuner.args
+		started = time.time()
+
+		url = urlsplit(self.path)
+		method = parse_qs(url.query).get("method", [""])[0]
+		raw = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+		try:
+			if url.path != "/services/json/":
+				raise RpcError(CODE_INTERNAL, "Unknown path")
+			result = tuner.call(method, url.query, tuner.body(method, raw))
+			reply = {"stat": "ok", "result": result}
+		except RpcError as e:
+			reply = {"stat": "fail", "code": e.code, "message": str(e)}
+
+		payload = json.dumps(reply, separators=(",", ":")).encode("utf-8")
+
+		delay = args.latency + random.uniform(0, args.jitter)
+		delay -= (time.time() - started) * 1000
+		if delay > 0:
+			time.sleep(delay / 1000.0)
+
+		self.send_response(200)
+		self.send_header("Content-Type", "text/plain; charset=utf-8")
+		self.send_header("Content-Length", str(len(payload)))
+		self.end_headers()
+		self.wfile.write(payload)
+
+
+def serve(tuner, port, context=None):
+	server = ThreadingHTTPServer((tuner.args.bind, port), Handler)
+	server.daemon_threads = True
+	server.tuner = tuner
+	if context:
+		server.socket = context.wrap_socket(server.socket, server_side=True)
+	thread = threading.Thread(target=server.serve_forever, daemon=True)
+	thread.start()
+	return server
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Mock Pandora rpc server")
+	parser.add_argument("--bind", default="127.0.0.1")
+	parser.add_argument("--port", type=int, default=8080,
+			help="plain http port, pianobar's rpc_host = <bind>:<port>")
+	parser.add_argument("--tls-port", type=int, default=0,
+			help="https port, pianobar's rpc_tls_port; needs --cert")
+	parser.add_argument("--cert", help="certificate (pem) for --tls-port")
+	parser.add_argument("--key", help="private key (pem) for --tls-port")
+	parser.add_argument("--encrypt-password", default=ENCRYPT_PASSWORD)
+	parser.add_argument("--decrypt-password", default=DECRYPT_PASSWORD)
+	parser.add_argument("--stations", type=int, default=20)
+	parser.add_argument("--playlist", type=int, default=4,
+			help="songs per station.getPlaylist")
+	parser.add_argument("--search", type=int, default=10,
+			help="artists and songs per music.search")
+	parser.add_argument("--genres", type=int, default=10)
+	parser.add_argument("--genre-stations", type=int, default=10)
+	parser.add_argument("--seeds", type=int, default=5)
+	parser.add_argument("--feedback", type=int, default=20)
+	parser.add_argument("--latency", type=float, default=0,
+			help="milliseconds before each response")
+	parser.add_argument("--jitter", type=float, default=0,
+			help="random milliseconds added to latency")
+	parser.add_argument("--audio-url", default="http://127.0.0.1/none.mp3")
+	parser.add_argument("--quiet", action="store_true")
+	args = parser.parse_args()
+
+	tuner = Tuner(args)
+	servers = [serve(tuner, args.port)]
+
+	if args.tls_port:
+		if not args.cert:
+			parser.error("--tls-port needs --cert")
+		context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+		context.load_cert_chain(args.cert, args.key)
+		servers.append(serve(tuner, args.tls_port, context))
+
+	print("mock tuner on %s:%d%s" % (args.bind, args.port,
+			", tls %d" % args.tls_port if args.tls_port else ""))
+	try:
+		while True:
+			time.sleep(3600)
+	except KeyboardInterrupt:
+		for server in servers:
+			server.shutdown()
+
+
+if __name__ == "__main__":
+	main()
@@ -1,5 +1,19 @@
 # pragma once
 
+/* clock_gettime and nanosleep of http_thread.h; must come before any
+ * system header, so include this file first */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+/* res_query and ns_* of http_resolver.c are not part of POSIX */
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE 1
+#endif
+#if !defined(_WIN32) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE 1
+#endif
+
 /* package name */
 #define PACKAGE "pianobar"
 
@@ -0,0 +1,609 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* portable libcurl backend, mainly useful to run pianobar's rpc code outside
+ * of Windows */
+
+#include "config.h"
+#include "../http_private.h"
+#include "../http_resolver.h"
+
+#ifdef HAVE_LIBCURL
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <curl/curl.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "libcurl.lib")
+#endif
+
+static struct _http_curl_static_t
+{
+	bool		done;
+	bool		initialized;
+} HttpCurlGlobal = { 0 };
+
+/* easy handle and the state of its transfer */
+typedef struct _http_curl_transfer {
+	CURL*			handle;
+	/* target of the transfer in progress */
+	http_buffer*	response;
+	CURLcode		result;
+	char			errorBuffer[CURL_ERROR_SIZE];
+	/* of the resolve list the handle was given last, see resolveList */
+	unsigned int	resolveGeneration;
+} http_curl_transfer;
+
+struct _http_t {
+	/* multi handle owns connection cache, sockets stay open between
+	 * requests and are picked by (host, port, secure) */
+	CURLM*			multi;
+	/* first one is used by single requests, the others are made by the
+	 * first batch that needs them */
+	http_curl_transfer	transfers[HTTP_BATCH_MAX];
+	/* tls sessions and dns entries survive easy handle reuse */
+	CURLSH*			share;
+	HttpStats_t*	stats;
+	/* advertise and decode gzip/deflate */
+	bool			compression;
+	char*			endpoint;
+	char*			securePort;
+	/* port of rpc host given as host:port, NULL otherwise */
+	char*			plainPort;
+	/* pins endpoint to the addresses found by the background resolver,
+	 * rebuilt whenever its generation changes and handed to every handle
+	 * before its next transfer */
+	http_resolver*	resolver;
+	unsigned int	resolveGeneration;
+	struct curl_slist*	resolveList;
+	char*			proxy;
+	unsigned int	timeOut;
+	char*			error;
+};
+
+static void HttpCurlStaticTerm (void) {
+	if (HttpCurlGlobal.initialized)
+		curl_global_cleanup ();
+	HttpCurlGlobal.initialized = false;
+}
+
+static bool HttpCurlStaticInit (void) {
+	if (HttpCurlGlobal.done)
+		return HttpCurlGlobal.initialized;
+
+	HttpCurlGlobal.done = true;
+
+	if (curl_global_init (CURL_GLOBAL_DEFAULT) != CURLE_OK)
+		return false;
+
+	atexit (HttpCurlStaticTerm);
+
+	HttpCurlGlobal.initialized = true;
+
+	return true;
+}
+
+static void HttpCurlSetLastError (http_t http, const char* message) {
+	free(http->error);
+	http->error = NULL;
+
+	if (message)
+		http->error = strdup(message);
+}
+
+static void HttpCurlSetLastErrorFromCode (http_t http,
+		const http_curl_transfer* transfer, CURLcode code) {
+	if (transfer->errorBuffer[0] != '\0')
+		HttpCurlSetLastError (http, transfer->errorBuffer);
+	else
+		HttpCurlSetLastError (http, curl_easy_strerror (code));
+}
+
+static size_t HttpCurlWrite (char* ptr, size_t size, size_t nmemb,
+		void* userData) {
+	http_curl_transfer* transfer = userData;
+	const size_t bytes = size * nmemb;
+
+	if (transfer->response->size == 0) {
+		/* first chunk, headers are in, size buffer for the whole body;
+		 * for encoded responses this is the compressed size, which is
+		 * still a good start */
+		curl_off_t contentLength = -1;
+		curl_easy_getinfo (transfer->handle,
+				CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength);
+		if (contentLength > 0 &&
+				!HttpBufferReserve (transfer->response, (size_t)contentLength))
+			return 0;
+	}
+
+	if (!HttpBufferAppend (transfer->response, ptr, bytes))
+		return 0;
+
+	return bytes;
+}
+
+/*	set options that do not change between requests
+ */
+static void HttpCurlSetupHandle (http_t http, http_curl_transfer* transfer) {
+	CURL* handle = transfer->handle;
+
+	curl_easy_setopt (handle, CURLOPT_SHARE, http->share);
+	curl_easy_setopt (handle, CURLOPT_USERAGENT, PACKAGE "/" VERSION);
+	curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION, HttpCurlWrite);
+	curl_easy_setopt (handle, CURLOPT_WRITEDATA, transfer);
+	curl_easy_setopt (handle, CURLOPT_ERRORBUFFER, transfer->errorBuffer);
+	curl_easy_setopt (handle, CURLOPT_CONNECTTIMEOUT, (long)http->timeOut);
+	curl_easy_setopt (handle, CURLOPT_TIMEOUT, (long)http->timeOut);
+	curl_easy_setopt (handle, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt (handle, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt (handle, CURLOPT_TCP_KEEPIDLE, 60L);
+	curl_easy_setopt (handle, CURLOPT_TCP_KEEPINTVL, 30L);
+	curl_easy_setopt (handle, CURLOPT_SSL_SESSIONID_CACHE, 1L);
+	/* resolver interleaves v4 and v6 addresses, give the second family a
+	 * quick chance if the first one does not answer */
+	curl_easy_setopt (handle, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, 200L);
+	/* offer http/2 over tls; transfers of a batch wait for the first
+	 * connection instead of opening their own, so they end up as streams
+	 * of it if the server agrees */
+	curl_easy_setopt (handle, CURLOPT_HTTP_VERSION,
+			(long)CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt (handle, CURLOPT_PIPEWAIT, 1L);
+}
+
+/*	rebuild resolve list from the addresses of the background resolver,
+ *	so requests never wait for a lookup; without addresses (yet) curl
+ *	resolves on its own
+ */
+static void HttpCurlUpdateResolve (http_t http) {
+#if LIBCURL_VERSION_NUM >= 0x073b00
+	const char* ports[2];
+	char addresses[HTTP_RESOLVER_ADDRESSES];
+	char entry[HTTP_RESOLVER_ADDRESSES + 512];
+	struct curl_slist* list = NULL;
+	unsigned int generation;
+	size_t i;
+
+	if (!http->resolver)
+		return;
+
+	generation = HttpResolverGet (http->resolver, addresses, sizeof(addresses));
+	if (generation == 0 || generation == http->resolveGeneration)
+		return;
+
+	ports[0] = http->plainPort ? http->plainPort : "80";
+	ports[1] = http->securePort;
+
+	/* previous entries have to be removed first, curl keeps the oldest */
+	for (i = 0; i < sizeof(ports) / sizeof(ports[0]); ++i) {
+		struct curl_slist* next;
+
+		snprintf(entry, sizeof(entry), "-%s:%s", http->endpoint, ports[i]);
+		if (!(next = curl_slist_append (list, entry)))
+			goto error;
+		list = next;
+
+		snprintf(entry, sizeof(entry), "%s:%s:%s", http->endpoint, ports[i],
+				addresses);
+		if (!(next = curl_slist_append (list, entry)))
+			goto error;
+		list = next;
+	}
+
+	/* handles still pointing to the old list get the new one in
+	 * HttpCurlPrepare, curl reads it only when a transfer starts */
+	curl_slist_free_all (http->resolveList);
+	http->resolveList = list;
+	http->resolveGeneration = generation;
+	return;
+
+error:
+	/* try again with next request */
+	curl_slist_free_all (list);
+#else
+	(void)http;
+#endif
+}
+
+/*	time between two points of curl's transfer timeline, those are 0 for
+ *	steps that were skipped
+ */
+static unsigned long long HttpCurlSpan (curl_off_t from, curl_off_t to) {
+	return to > from ? (unsigned long long)(to - from) : 0;
+}
+
+/*	fill metrics after transfer, size of download is counted before content
+ *	decoding
+ */
+static void HttpCurlGetMetrics (const http_curl_transfer* transfer,
+		http_metrics* metrics) {
+	curl_off_t nameLookup = 0, connect = 0, appConnect = 0, preTransfer = 0,
+		postTransfer = 0, startTransfer = 0, total = 0, received = 0;
+
+	curl_easy_getinfo (transfer->handle, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+	curl_easy_getinfo (transfer->handle, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo (transfer->handle, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+	curl_easy_getinfo (transfer->handle, CURLINFO_PRETRANSFER_TIME_T, &preTransfer);
+	curl_easy_getinfo (transfer->handle, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+	curl_easy_getinfo (transfer->handle, CURLINFO_TOTAL_TIME_T, &total);
+#if LIBCURL_VERSION_NUM >= 0x080a00
+	curl_easy_getinfo (transfer->handle, CURLINFO_POSTTRANSFER_TIME_T, &postTransfer);
+#endif
+	/* older versions do not tell when the request was out, sending is
+	 * counted as waiting then */
+	if (postTransfer < preTransfer)
+		postTransfer = preTransfer;
+
+	metrics->phase[HTTP_PHASE_DNS]     = HttpCurlSpan (0, nameLookup);
+	metrics->phase[HTTP_PHASE_CONNECT] = HttpCurlSpan (nameLookup, connect);
+	metrics->phase[HTTP_PHASE_TLS]     = HttpCurlSpan (connect, appConnect);
+	metrics->phase[HTTP_PHASE_SEND]    = HttpCurlSpan (preTransfer, postTransfer);
+	metrics->phase[HTTP_PHASE_WAIT]    = HttpCurlSpan (postTransfer, startTransfer);
+	metrics->phase[HTTP_PHASE_BODY]    = HttpCurlSpan (startTransfer, total);
+	metrics->phase[HTTP_PHASE_TOTAL]   = HttpCurlSpan (0, total);
+
+	if (curl_easy_getinfo (transfer->handle, CURLINFO_SIZE_DOWNLOAD_T,
+			&received) != CURLE_OK || received < 0)
+		received = (curl_off_t)transfer->response->size;
+	metrics->bytesReceived = (unsigned long long)received;
+}
+
+/*	update pool counters after transfer; libcurl does not report whether a
+ *	tls handshake resumed a session, so tlsResumed stays unknown
+ *	@param http handle
+ *	@param finished transfer
+ */
+static void HttpCurlUpdatePoolStats (http_t http,
+		const http_curl_transfer* transfer) {
+	long connects = 0;
+
+	curl_easy_getinfo (transfer->handle, CURLINFO_NUM_CONNECTS, &connects);
+	if (connects == 0)
+		++http->stats->poolHits;
+	else
+		++http->stats->poolMisses;
+}
+
+static http_t HttpCurlCreate (const http_config* config) {
+	http_t out;
+
+	if (!HttpCurlStaticInit ())
+		return NULL;
+
+	out = malloc(sizeof(struct _http_t));
+	if (!out)
+		return NULL;
+	memset(out, 0, sizeof(struct _http_t));
+
+	out->endpoint   = strdup(config->endpoint);
+	out->securePort = strdup(config->securePort);
+	out->timeOut    = config->timeOut;
+	out->stats      = config->stats;
+	out->resolver   = config->resolver;
+	out->multi      = curl_multi_init ();
+	out->share      = curl_share_init ();
+	out->transfers[0].handle = curl_easy_init ();
+
+	/* split host:port, a second colon means an ipv6 address without port */
+	if (out->endpoint) {
+		char* colon = strchr(out->endpoint, ':');
+		if (colon && !strchr(colon + 1, ':')) {
+			*colon = '\0';
+			out->plainPort = colon + 1;
+		}
+	}
+
+	if (!out->endpoint || !out->securePort || !out->multi ||
+			!out->transfers[0].handle || !out->share) {
+		if (out->share)
+			curl_share_cleanup (out->share);
+		if (out->transfers[0].handle)
+			curl_easy_cleanup (out->transfers[0].handle);
+		if (out->multi)
+			curl_multi_cleanup (out->multi);
+		free(out->endpoint);
+		free(out->securePort);
+		free(out);
+		return NULL;
+	}
+
+	curl_share_setopt (out->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	curl_share_setopt (out->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+
+	/* one plaintext and one tls connection is all pianobar needs, keep
+	 * some spare room for proxies */
+	curl_multi_setopt (out->multi, CURLMOPT_MAXCONNECTS, 4L);
+#ifdef CURLPIPE_MULTIPLEX
+	/* default since 7.62, older versions need to be asked */
+	curl_multi_setopt (out->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+	out->compression = true;
+
+	HttpCurlSetupHandle (out, &out->transfers[0]);
+
+	return out;
+}
+
+static void HttpCurlDestroy (http_t http) {
+	if (http) {
+		size_t i;
+		for (i = 0; i < HTTP_BATCH_MAX; ++i)
+			if (http->transfers[i].handle)
+				curl_easy_cleanup (http->transfers[i].handle);
+		curl_multi_cleanup (http->multi);
+		curl_share_cleanup (http->share);
+		curl_slist_free_all (http->resolveList);
+		free(http->endpoint);
+		free(http->securePort);
+		free(http->proxy);
+		free(http->error);
+	}
+	free(http);
+}
+
+static bool HttpCurlSetAutoProxy (http_t http, const char* url) {
+	(void)url;
+	HttpCurlSetLastError (http, "Automatic proxy configuration is not "
+			"supported by this backend");
+	return false;
+}
+
+static void HttpCurlSetCompression (http_t http, bool enabled) {
+	http->compression = enabled;
+}
+
+static bool HttpCurlSetProxy (http_t http, const char* url) {
+	char* proxy = NULL;
+
+	if (url && !(proxy = strdup(url)))
+		return false;
+
+	free(http->proxy);
+	http->proxy = proxy;
+	return true;
+}
+
+/*	run transfers on the multi handle until all are done, result of each
+ *	goes to its transfer
+ *	@param http handle
+ *	@param number of transfers, starting with the first one
+ */
+static void HttpCurlPerform (http_t http, size_t count) {
+	CURLMcode multiResult = CURLM_OK;
+	size_t added, i;
+	int running = 1;
+
+	/* transfers the multi handle never reports on keep this */
+	for (i = 0; i < count; ++i)
+		http->transfers[i].result = CURLE_FAILED_INIT;
+
+	for (added = 0; added < count; ++added) {
+		if (curl_multi_add_handle (http->multi,
+				http->transfers[added].handle) != CURLM_OK)
+			break;
+	}
+
+	/* never started, told apart from the others by their message */
+	for (i = added; i < count; ++i)
+		snprintf (http->transfers[i].errorBuffer,
+				sizeof (http->transfers[i].errorBuffer),
+				"Could not start transfer");
+
+	if (added == 0)
+		return;
+
+	while (running) {
+		multiResult = curl_multi_perform (http->multi, &running);
+		if (multiResult != CURLM_OK)
+			break;
+
+		if (running)
+			curl_multi_wait (http->multi, NULL, 0, 1000, NULL);
+	}
+
+	if (multiResult == CURLM_OK) {
+		CURLMsg* message;
+		int messagesLeft;
+		while ((message = curl_multi_info_read (http->multi, &messagesLeft))) {
+			if (message->msg != CURLMSG_DONE)
+				continue;
+			for (i = 0; i < added; ++i)
+				if (message->easy_handle == http->transfers[i].handle)
+					http->transfers[i].result = message->data.result;
+		}
+	}
+
+	for (i = 0; i < added; ++i)
+		curl_multi_remove_handle (http->multi, http->transfers[i].handle);
+}
+
+/*	set up transfer for request
+ */
+static void HttpCurlPrepare (http_t http, http_curl_transfer* transfer,
+		PianoRequest_t * const request, http_buffer* response,
+		http_metrics* metrics) {
+	char url[2048];
+
+	transfer->response = response;
+	transfer->errorBuffer[0] = '\0';
+
+#if LIBCURL_VERSION_NUM >= 0x073b00
+	/* entries go into the shared dns cache, but only when a transfer of
+	 * this handle starts; every handle has to carry them */
+	if (transfer->resolveGeneration != http->resolveGeneration) {
+		curl_easy_setopt (transfer->handle, CURLOPT_RESOLVE,
+				http->resolveList);
+		transfer->resolveGeneration = http->resolveGeneration;
+	}
+#endif
+
+	if (request->secure)
+		snprintf(url, sizeof(url), "https://%s:%s%s", http->endpoint,
+				http->securePort, request->urlPath);
+	else if (http->plainPort)
+		snprintf(url, sizeof(url), "http://%s:%s%s", http->endpoint,
+				http->plainPort, request->urlPath);
+	else
+		snprintf(url, sizeof(url), "http://%s%s", http->endpoint,
+				request->urlPath);
+
+	/* no curl_easy_reset here, it would drop the handle's hold on
+	 * its pooled connections */
+	curl_easy_setopt (transfer->handle, CURLOPT_URL, url);
+	curl_easy_setopt (transfer->handle, CURLOPT_POSTFIELDS, request->postData);
+	curl_easy_setopt (transfer->handle, CURLOPT_POSTFIELDSIZE,
+			(long)strlen(request->postData));
+	metrics->bytesSent = strlen(request->postData);
+	curl_easy_setopt (transfer->handle, CURLOPT_PROXY, http->proxy);
+	/* empty string offers every encoding libcurl was built with */
+	curl_easy_setopt (transfer->handle, CURLOPT_ACCEPT_ENCODING,
+			http->compression ? "" : NULL);
+}
+
+/*	outcome of finished transfer
+ */
+static http_status HttpCurlFinish (http_t http, http_curl_transfer* transfer,
+		unsigned int* retryAfter, http_metrics* metrics) {
+	const CURLcode code = transfer->result;
+	long statusCode = 0;
+
+	if (code == CURLE_OK) {
+		curl_easy_getinfo (transfer->handle, CURLINFO_RESPONSE_CODE,
+				&statusCode);
+		HttpCurlUpdatePoolStats (http, transfer);
+		HttpCurlGetMetrics (transfer, metrics);
+	}
+
+	switch (code) {
+		case CURLE_OK:
+			if (statusCode == 429 || (statusCode >= 500 && statusCode <= 599)) {
+#if LIBCURL_VERSION_NUM >= 0x074200
+				curl_off_t wait = 0;
+				if (curl_easy_getinfo (transfer->handle, CURLINFO_RETRY_AFTER,
+						&wait) == CURLE_OK && wait > 0)
+					*retryAfter = (unsigned int)wait;
+#endif
+				HttpCurlSetLastError (http, "Server error");
+				return HTTP_STATUS_TRANSIENT;
+			}
+			else if (statusCode == 407) {
+				HttpCurlSetLastError (http, "Proxy authentication required");
+				return HTTP_STATUS_FATAL;
+			}
+			break;
+
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+			/* pinned addresses may be stale, look up again */
+			if (http->resolver)
+				HttpResolverInvalidate (http->resolver);
+			/* fall through */
+
+		case CURLE_COULDNT_RESOLVE_PROXY:
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+		case CURLE_GOT_NOTHING:
+			HttpCurlSetLastErrorFromCode (http, transfer, code);
+			return HTTP_STATUS_TRANSIENT;
+
+		default:
+			HttpCurlSetLastErrorFromCode (http, transfer, code);
+			return HTTP_STATUS_FATAL;
+	}
+
+	HttpCurlSetLastError (http, NULL);
+
+	return HTTP_STATUS_OK;
+}
+
+static http_status HttpCurlRequest (http_t http,
+		PianoRequest_t * const request, http_buffer* response,
+		unsigned int* retryAfter, http_metrics* metrics) {
+	http_curl_transfer* transfer = &http->transfers[0];
+
+	HttpCurlUpdateResolve (http);
+	HttpCurlPrepare (http, transfer, request, response, metrics);
+	HttpCurlPerform (http, 1);
+
+	return HttpCurlFinish (http, transfer, retryAfter, metrics);
+}
+
+/*	all requests of the batch run on the multi handle at once; over tls
+ *	they share one http/2 connection if the server speaks it, otherwise
+ *	each gets a connection of its own
+ */
+static void HttpCurlRequestBatch (http_t http, http_batch_item* items,
+		size_t count) {
+	size_t ready, i;
+
+	for (ready = 0; ready < count && ready < HTTP_BATCH_MAX; ++ready) {
+		http_curl_transfer* transfer = &http->transfers[ready];
+
+		if (!transfer->handle) {
+			if (!(transfer->handle = curl_easy_init ()))
+				break;
+			HttpCurlSetupHandle (http, transfer);
+		}
+	}
+
+	HttpCurlUpdateResolve (http);
+	for (i = 0; i < ready; ++i)
+		HttpCurlPrepare (http, &http->transfers[i], items[i].request,
+				items[i].response, &items[i].metrics);
+
+	HttpCurlPerform (http, ready);
+
+	for (i = 0; i < ready; ++i)
+		items[i].status = HttpCurlFinish (http, &http->transfers[i],
+				&items[i].retryAfter, &items[i].metrics);
+
+	/* out of handles, those were not sent yet and go one after another;
+	 * the dispatcher does not repeat failed requests that are not
+	 * read-only */
+	for (i = ready; i < count; ++i)
+		items[i].status = HttpCurlRequest (http, items[i].request,
+				items[i].response, &items[i].retryAfter, &items[i].metrics);
+}
+
+static const char* HttpCurlGetError (http_t http) {
+	return http->error;
+}
+
+http_iface http_curl =
+{
+	.Id				= "curl",
+	.Name			= "libcurl",
+	.Create			= HttpCurlCreate,
+	.Destroy		= HttpCurlDestroy,
+	.SetAutoProxy	= HttpCurlSetAutoProxy,
+	.SetProxy		= HttpCurlSetProxy,
+	.SetCompression	= HttpCurlSetCompression,
+	.Request		= HttpCurlRequest,
+	.RequestBatch	= HttpCurlRequestBatch,
+	.GetError		= HttpCurlGetError
+};
+
+#endif /* HAVE_LIBCURL */
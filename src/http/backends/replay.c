@@ -0,0 +1,280 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* serves responses saved by HttpSetRecordFile, lets the whole rpc path run
+ * without network access */
+
+#include "config.h"
+#include "../http_private.h"
+#include "../http_thread.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+	PianoRequestType_t	type;
+	/* milliseconds the request took when it was recorded */
+	unsigned int		latency;
+	char*				urlPath;
+	char*				postData;
+	char*				response;
+	size_t				responseSize;
+} HttpReplayEntry_t;
+
+struct _http_t {
+	HttpReplayEntry_t*	entries;
+	size_t				count;
+	size_t				capacity;
+	/* entries are served in recorded order, search starts here */
+	size_t				next;
+	/* negative to use recorded latency */
+	int					latency;
+	char*				error;
+};
+
+static void HttpReplaySetLastError (http_t http, const char* message) {
+	free(http->error);
+	http->error = NULL;
+
+	if (message)
+		http->error = strdup(message);
+}
+
+/*	read size bytes and NUL-terminate them
+ *	@return buffer or NULL on short read
+ */
+static char* HttpReplayReadBlock (FILE* file, size_t size) {
+	char* block = malloc(size + 1);
+	if (!block)
+		return NULL;
+
+	if (fread(block, 1, size, file) != size) {
+		free(block);
+		return NULL;
+	}
+
+	block[size] = 0;
+	return block;
+}
+
+static bool HttpReplayLoad (http_t http, const char* path) {
+	char magic[sizeof(HTTP_RECORD_MAGIC)];
+	bool result = false;
+	FILE* file;
+
+	file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	if (!fgets(magic, sizeof(magic), file) ||
+			strcmp(magic, HTTP_RECORD_MAGIC) != 0)
+		goto done;
+
+	for (;;) {
+		HttpReplayEntry_t* entry;
+		unsigned long urlPathSize, postDataSize, responseSize;
+		unsigned int latency;
+		int type, fields;
+
+		fields = fscanf(file, "%d %u %lu %lu %lu", &type, &latency,
+				&urlPathSize, &postDataSize, &responseSize);
+		if (fields == EOF)
+			break;
+		if (fields != 5 || fgetc(file) != '\n')
+			goto done;
+
+		if (http->count == http->capacity) {
+			size_t capacity = http->capacity ? http->capacity * 2 : 64;
+			HttpReplayEntry_t* entries = realloc(http->entries,
+					capacity * sizeof(*entries));
+			if (!entries)
+				goto done;
+			http->entries  = entries;
+			http->capacity = capacity;
+		}
+
+		entry = &http->entries[http->count];
+		memset(entry, 0, sizeof(*entry));
+		/* counted right away, so a partially read entry is freed too */
+		++http->count;
+
+		entry->type         = (PianoRequestType_t)type;
+		entry->latency      = latency;
+		entry->responseSize = responseSize;
+
+		if (!(entry->urlPath = HttpReplayReadBlock(file, urlPathSize)) ||
+				!(entry->postData = HttpReplayReadBlock(file, postDataSize)) ||
+				!(entry->response = HttpReplayReadBlock(file, responseSize)) ||
+				fgetc(file) != '\n')
+			goto done;
+	}
+
+	result = http->count > 0;
+
+done:
+	fclose(file);
+	return result;
+}
+
+/*	requests of one type may call different methods (login steps), so
+ *	they are told apart by method= of the url
+ */
+static bool HttpReplaySameMethod (const char* urlPath, const char* other) {
+	const char* method = strstr(urlPath, "method=");
+	const char* otherMethod = strstr(other, "method=");
+	size_t size;
+
+	if (!method || !otherMethod)
+		return method == otherMethod;
+
+	size = strcspn(method, "&");
+	return size == strcspn(otherMethod, "&") &&
+		memcmp(method, otherMethod, size) == 0;
+}
+
+/*	next recorded entry matching request, wraps around so a recording can
+ *	be played in a loop
+ */
+static const HttpReplayEntry_t* HttpReplayFind (http_t http,
+		const PianoRequest_t* request) {
+	size_t i;
+
+	for (i = 0; i < http->count; ++i) {
+		const size_t index = (http->next + i) % http->count;
+		const HttpReplayEntry_t* entry = &http->entries[index];
+
+		if (entry->type == request->type &&
+				HttpReplaySameMethod(entry->urlPath, request->urlPath)) {
+			http->next = index + 1;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void HttpReplayDestroy (http_t http) {
+	size_t i;
+
+	if (http) {
+		for (i = 0; i < http->count; ++i) {
+			free(http->entries[i].urlPath);
+			free(http->entries[i].postData);
+			free(http->entries[i].response);
+		}
+		free(http->entries);
+		free(http->error);
+	}
+	free(http);
+}
+
+static http_t HttpReplayCreate (const http_config* config) {
+	http_t out;
+
+	if (!config->replayFile)
+		return NULL;
+
+	out = malloc(sizeof(struct _http_t));
+	if (!out)
+		return NULL;
+	memset(out, 0, sizeof(struct _http_t));
+
+	out->latency = config->replayLatency;
+
+	if (!HttpReplayLoad (out, config->replayFile)) {
+		HttpReplayDestroy (out);
+		return NULL;
+	}
+
+	return out;
+}
+
+/* there is no network, proxies and encodings do not matter */
+static bool HttpReplaySetAutoProxy (http_t http, const char* url) {
+	(void)http;
+	(void)url;
+	return true;
+}
+
+static bool HttpReplaySetProxy (http_t http, const char* url) {
+	(void)http;
+	(void)url;
+	return true;
+}
+
+static void HttpReplaySetCompression (http_t http, bool enabled) {
+	(void)http;
+	(void)enabled;
+}
+
+static http_status HttpReplayRequest (http_t http,
+		PianoRequest_t * const request, http_buffer* response,
+		unsigned int* retryAfter, http_metrics* metrics) {
+	const HttpReplayEntry_t* entry;
+	unsigned int latency;
+
+	/* recordings do not keep it */
+	(void)retryAfter;
+
+	entry = HttpReplayFind (http, request);
+	if (!entry) {
+		HttpReplaySetLastError (http, "No recorded response for this request");
+		return HTTP_STATUS_FATAL;
+	}
+
+	latency = http->latency < 0 ? entry->latency : (unsigned int)http->latency;
+	if (latency > 0)
+		HttpSleep(latency);
+
+	if (!HttpBufferAppend(response, entry->response, entry->responseSize)) {
+		HttpReplaySetLastError (http, "Out of memory");
+		return HTTP_STATUS_FATAL;
+	}
+
+	/* whole recorded latency is waiting for the server */
+	metrics->phase[HTTP_PHASE_WAIT] = latency * 1000ull;
+	metrics->bytesSent     = request->postData ? strlen(request->postData) : 0;
+	metrics->bytesReceived = entry->responseSize;
+
+	HttpReplaySetLastError (http, NULL);
+
+	return HTTP_STATUS_OK;
+}
+
+static const char* HttpReplayGetError (http_t http) {
+	return http->error;
+}
+
+http_iface http_replay =
+{
+	.Id				= "replay",
+	.Name			= "Recorded responses",
+	.Create			= HttpReplayCreate,
+	.Destroy		= HttpReplayDestroy,
+	.SetAutoProxy	= HttpReplaySetAutoProxy,
+	.SetProxy		= HttpReplaySetProxy,
+	.SetCompression	= HttpReplaySetCompression,
+	.Request		= HttpReplayRequest,
+	.GetError		= HttpReplayGetError
+};
@@ -0,0 +1,1088 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "config.h"
+#include "../http_private.h"
+#include "../http_resolver.h"
+#include "../http_thread.h"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <winhttp.h>
+#pragma comment(lib, "winhttp.lib")
+
+/* connection handles are kept per (host, port, secure) triple, WinHTTP keeps
+ * the sockets behind them alive between requests */
+# define HTTP_POOL_SIZE 4
+
+typedef struct {
+	wchar_t*		host;
+	INTERNET_PORT	port;
+	bool			secure;
+	HINTERNET		connection;
+} HttpPoolEntry_t;
+
+/* proxy decisions of the PAC script are cached per (host, secure) and
+ * refreshed in background before they expire, so the script is not run
+ * for every request */
+# define HTTP_PROXY_CACHE_SIZE		4
+# define HTTP_PROXY_CACHE_TTL		(15 * 60 * 1000)
+# define HTTP_PROXY_CACHE_REFRESH	(60 * 1000)
+
+typedef struct {
+	wchar_t*		host;
+	bool			secure;
+	/* false until the first evaluation finished */
+	bool			resolved;
+	DWORD			accessType;
+	wchar_t*		proxy;
+	wchar_t*		proxyBypass;
+	unsigned long long	expires;
+} HttpProxyCacheEntry_t;
+
+struct _http_t {
+	HINTERNET		session;
+	HttpPoolEntry_t	pool[HTTP_POOL_SIZE];
+	HttpStats_t*	stats;
+	wchar_t*		endpoint;
+	wchar_t*		securePort;
+	/* rpc host may name one, e.g. for a local mock server */
+	INTERNET_PORT	plainPort;
+	/* WinHTTP cannot be handed addresses, but the resolver's lookups keep
+	 * the system dns cache warm; asked to look again when a name fails */
+	http_resolver*	resolver;
+	/* let WinHTTP advertise and decode gzip/deflate */
+	bool			compression;
+
+	/* guards autoProxy and proxyCache, refresher thread uses them too */
+	http_mutex		proxyLock;
+	http_cond		proxyWake;
+	http_thread		proxyRefresher;
+	bool			proxyRefresherRunning;
+	bool			proxyRefresherQuit;
+	HttpProxyCacheEntry_t	proxyCache[HTTP_PROXY_CACHE_SIZE];
+	wchar_t*		autoProxy;
+	wchar_t*		proxy;
+	wchar_t*		proxyUsername;
+	wchar_t*		proxyPassword;
+	char*			error;
+};
+
+static char* HttpToString(const wchar_t* wideString, size_t size);
+static wchar_t* HttpToWideString(const char* string, size_t size);
+static bool HttpCreateConnection (http_t http, unsigned int timeOut);
+static void HttpCloseConnection (http_t http);
+static HINTERNET HttpGetConnection (http_t http, bool secure);
+static void HttpProxyCacheClear (http_t http);
+static void HttpProxyRefresherStop (http_t http);
+static void HttpSetLastError (http_t http, const char* message);
+static void HttpSetLastErrorW (http_t http, const wchar_t* message);
+static void HttpSetLastErrorFromWinHttp (http_t http);
+static char* HttpFormatWinApiError (DWORD errorCode, HINSTANCE module);
+static char* HttpFormatWinHttpError (DWORD errorCode);
+static void HttpClearProxy (http_t http);
+static void HttpWinDestroy (http_t http);
+static bool HttpWinSetProxy (http_t http, const char* url);
+
+# define WINHTTP_SAFE(condition) do { if (condition) break; HttpSetLastErrorFromWinHttp (http); return false; } while (false)
+# define WINHTTP_SAFE_DONE(condition) do { if (condition) break; HttpSetLastErrorFromWinHttp (http); goto done; } while (false)
+
+static char* HttpToString(const wchar_t* wideString, size_t size) {
+	int utfSize = WideCharToMultiByte(CP_UTF8, 0, wideString, (int)size, NULL, 0, NULL, NULL);
+	char* utfMessage = malloc(utfSize + 1);
+	if (utfMessage)	{
+		utfMessage[utfSize] = 0;
+		WideCharToMultiByte(CP_UTF8, 0, wideString, (int)size, utfMessage, utfSize, NULL, NULL);
+	}
+	return utfMessage;
+}
+
+static wchar_t* HttpToWideString(const char* string, size_t size) {
+	int wideSize = MultiByteToWideChar(CP_UTF8, 0, string, (int)size, NULL, 0);
+	int wideBytes = (wideSize + 1) * sizeof(wchar_t);
+	wchar_t* wideMessage = malloc(wideBytes);
+	if (wideMessage) {
+		wideMessage[wideSize] = 0;
+		MultiByteToWideChar(CP_UTF8, 0, string, (int)size, wideMessage, wideSize);
+	}
+	return wideMessage;
+}
+
+
+static bool HttpCreateConnection (http_t http, unsigned int timeOut) {
+	HttpCloseConnection (http);
+
+	http->session = WinHttpOpen(
+		L"WinHTTP/1.0",
+		WINHTTP_ACCESS_TYPE_NO_PROXY,
+		WINHTTP_NO_PROXY_NAME,
+		WINHTTP_NO_PROXY_BYPASS,
+		0);
+	WINHTTP_SAFE(http->session != NULL);
+
+	WinHttpSetTimeouts(http->session,
+		timeOut * 1000,  // DNS time-out
+		timeOut * 1000,  // connect time-out
+		timeOut * 1000,  // send time-out
+		timeOut * 1000); // receive time-out
+
+	/* both kinds of requests are made right after login, connect early */
+	WINHTTP_SAFE(HttpGetConnection (http, true) != NULL);
+	WINHTTP_SAFE(HttpGetConnection (http, false) != NULL);
+
+	return true;
+}
+
+static void HttpCloseConnection (http_t http) {
+	int i;
+
+	for (i = 0; i < HTTP_POOL_SIZE; ++i) {
+		HttpPoolEntry_t* entry = &http->pool[i];
+		if (entry->connection)
+			WinHttpCloseHandle(entry->connection);
+		free(entry->host);
+		memset(entry, 0, sizeof(*entry));
+	}
+
+	if (http->session) {
+		WinHttpCloseHandle(http->session);
+		http->session = NULL;
+	}
+}
+
+/*	find pooled connection for endpoint, create one if there is none yet
+ *	@param http handle
+ *	@param use tls port
+ *	@return connection handle or NULL
+ */
+static HINTERNET HttpGetConnection (http_t http, bool secure) {
+	INTERNET_PORT port = secure ?
+		(INTERNET_PORT)_wtoi(http->securePort) : http->plainPort;
+	HttpPoolEntry_t* slot = NULL;
+	int i;
+
+	if (port == 0)
+		port = INTERNET_DEFAULT_HTTPS_PORT;
+
+	for (i = 0; i < HTTP_POOL_SIZE; ++i) {
+		HttpPoolEntry_t* entry = &http->pool[i];
+		if (!entry->connection) {
+			if (!slot)
+				slot = entry;
+			continue;
+		}
+
+		if (entry->port == port && entry->secure == secure &&
+				wcscmp(entry->host, http->endpoint) == 0)
+			return entry->connection;
+	}
+
+	if (!slot) {
+		/* pool is full, recycle oldest entry */
+		WinHttpCloseHandle(http->pool[0].connection);
+		free(http->pool[0].host);
+		memmove(&http->pool[0], &http->pool[1],
+			sizeof(HttpPoolEntry_t) * (HTTP_POOL_SIZE - 1));
+		slot = &http->pool[HTTP_POOL_SIZE - 1];
+		memset(slot, 0, sizeof(*slot));
+	}
+
+	slot->connection = WinHttpConnect(http->session, http->endpoint, port, 0);
+	if (!slot->connection)
+		return NULL;
+
+	slot->host   = _wcsdup(http->endpoint);
+	slot->port   = port;
+	slot->secure = secure;
+
+	return slot->connection;
+}
+
+/*	update pool counters from WinHTTP's per request statistics, those tell
+ *	whether the socket and tls session have been reused
+ *	@param http handle
+ *	@param request handle
+ *	@param set to true if request opened a new connection
+ *	@return false if the system cannot tell
+ */
+static bool HttpUpdatePoolStats (http_t http, HINTERNET handle,
+		bool* newConnection) {
+#ifdef WINHTTP_OPTION_REQUEST_STATS
+	WINHTTP_REQUEST_STATS stats;
+	DWORD statsSize = sizeof(stats);
+
+	memset(&stats, 0, sizeof(stats));
+	if (WinHttpQueryOption(handle, WINHTTP_OPTION_REQUEST_STATS, &stats, &statsSize)) {
+		http->stats->tlsResumedKnown = true;
+		if (stats.ullFlags & WINHTTP_REQUEST_STAT_FLAG_TLS_SESSION_RESUMPTION)
+			++http->stats->tlsResumed;
+
+		*newConnection =
+			(stats.ullFlags & WINHTTP_REQUEST_STAT_FLAG_FIRST_REQUEST) != 0;
+		if (*newConnection)
+			++http->stats->poolMisses;
+		else
+			++http->stats->poolHits;
+		return true;
+	}
+#endif
+	/* older systems, no way to tell */
+	(void)handle;
+	++http->stats->poolHits;
+	*newConnection = false;
+	return false;
+}
+
+#ifdef WINHTTP_OPTION_REQUEST_TIMES
+/*	duration between two of WinHTTP's request timestamps
+ *	@return microseconds, 0 if the step did not happen
+ */
+static unsigned long long HttpRequestTimeSpan (const WINHTTP_REQUEST_TIMES* times,
+		int start, int end) {
+	const ULONGLONG startTime = times->rgullTimes[start];
+	const ULONGLONG endTime = times->rgullTimes[end];
+
+	if (startTime == 0 || endTime < startTime)
+		return 0;
+
+	/* 100 ns units */
+	return (endTime - startTime) / 10;
+}
+#endif
+
+/*	fill name resolution, connect, tls and send phases from WinHTTP's per
+ *	request timestamps
+ *	@param request handle
+ *	@param metrics of the request
+ *	@return false if the system does not provide them
+ */
+static bool HttpUpdatePhases (HINTERNET handle, http_metrics* metrics) {
+#ifdef WINHTTP_OPTION_REQUEST_TIMES
+	WINHTTP_REQUEST_TIMES times;
+	DWORD timesSize = sizeof(times);
+
+	memset(&times, 0, sizeof(times));
+	if (!WinHttpQueryOption(handle, WINHTTP_OPTION_REQUEST_TIMES, &times, &timesSize) ||
+		times.cTimes <= WinHttpReceiveResponseEnd)
+		return false;
+
+	metrics->phase[HTTP_PHASE_DNS] = HttpRequestTimeSpan (&times,
+		WinHttpNameResolutionStart, WinHttpNameResolutionEnd);
+	metrics->phase[HTTP_PHASE_CONNECT] = HttpRequestTimeSpan (&times,
+		WinHttpConnectionEstablishmentStart, WinHttpConnectionEstablishmentEnd);
+	/* tls 1.3 needs two legs only */
+	metrics->phase[HTTP_PHASE_TLS] = HttpRequestTimeSpan (&times,
+		WinHttpTlsHandshakeClientLeg1Start,
+		times.rgullTimes[WinHttpTlsHandshakeClientLeg3End] != 0 ?
+		WinHttpTlsHandshakeClientLeg3End : WinHttpTlsHandshakeClientLeg2End);
+	metrics->phase[HTTP_PHASE_SEND] = HttpRequestTimeSpan (&times,
+		WinHttpSendRequestStart, WinHttpSendRequestEnd);
+	return true;
+#else
+	(void)handle;
+	(void)metrics;
+	return false;
+#endif
+}
+
+static void HttpSetLastError (http_t http, const char* message) {
+	free(http->error);
+	http->error = NULL;
+
+	if (message)
+		http->error = strdup(message);
+}
+
+static void HttpSetLastErrorW (http_t http, const wchar_t* message) {
+	free(http->error);
+	http->error = NULL;
+
+	if (message)
+		http->error = HttpToString(message, wcslen(message));
+}
+
+static void HttpSetLastErrorFromWinHttp (http_t http) {
+	free(http->error);
+	http->error = NULL;
+
+	DWORD error = GetLastError();
+	if (error)
+		http->error = HttpFormatWinHttpError(error);
+}
+
+static char* HttpFormatWinApiError (DWORD errorCode, HINSTANCE module) {
+	const int source_flag = module ? FORMAT_MESSAGE_FROM_HMODULE : FORMAT_MESSAGE_FROM_SYSTEM;
+
+	HLOCAL buffer = NULL;
+	int bufferLength = FormatMessageW(
+		FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_IGNORE_INSERTS | source_flag,
+		(void*)module,
+		errorCode,
+		MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+		(LPWSTR)&buffer,
+		0,
+		NULL);
+
+	if (bufferLength > 0) {
+		char* message;
+
+		wchar_t* wideMessage = (wchar_t*)buffer;
+
+		/* Drop new line from the end. */
+		wchar_t* wideMessageBack = wideMessage + bufferLength - 1;
+		while (wideMessageBack > wideMessage && (*wideMessageBack == '\r' || *wideMessageBack == '\n'))
+			--wideMessageBack;
+
+		message = HttpToString (wideMessage, wideMessageBack - wideMessage + 1);
+
+		LocalFree(buffer);
+
+		return message;
+	}
+	else
+		return NULL;
+}
+
+static char* HttpFormatWinHttpError (DWORD errorCode) {
+	if (errorCode >= WINHTTP_ERROR_BASE && errorCode <= WINHTTP_ERROR_LAST) {
+		HMODULE module = GetModuleHandleW(L"WinHTTP.dll");
+		if (module) {
+			char* message = HttpFormatWinApiError(errorCode, module);
+			if (message)
+				return message;
+		}
+	}
+
+	return HttpFormatWinApiError(errorCode, NULL);
+}
+
+static http_t HttpWinCreate(const http_config* config) {
+	http_t out = malloc(sizeof(struct _http_t));
+	if (!out)
+		return NULL;
+	memset(out, 0, sizeof(struct _http_t));
+
+	out->stats      = config->stats;
+	out->resolver   = config->resolver;
+	out->endpoint   = HttpToWideString(config->endpoint, -1);
+	out->securePort = HttpToWideString(config->securePort, -1);
+	out->compression = true;
+
+	/* split host:port, a second colon means an ipv6 address without port */
+	out->plainPort = INTERNET_DEFAULT_HTTP_PORT;
+	if (out->endpoint) {
+		wchar_t* colon = wcschr(out->endpoint, L':');
+		if (colon && !wcschr(colon + 1, L':')) {
+			*colon = 0;
+			if (_wtoi(colon + 1) > 0)
+				out->plainPort = (INTERNET_PORT)_wtoi(colon + 1);
+		}
+	}
+
+	HttpMutexInit(&out->proxyLock);
+	HttpCondInit(&out->proxyWake);
+
+	if (!HttpCreateConnection (out, config->timeOut)) {
+		HttpWinDestroy (out);
+		return NULL;
+	}
+
+	return out;
+}
+
+static void HttpWinDestroy(http_t http) {
+	if (http) {
+		/* refresher uses the session, stop it first */
+		HttpProxyRefresherStop (http);
+		free(http->endpoint);
+		free(http->securePort);
+		http->endpoint = NULL;
+		http->securePort = NULL;
+		HttpCloseConnection (http);
+		HttpClearProxy (http);
+		HttpCondDestroy(&http->proxyWake);
+		HttpMutexDestroy(&http->proxyLock);
+	}
+	free(http);
+}
+
+static void HttpClearProxy (http_t http) {
+	HttpMutexLock(&http->proxyLock);
+	if (http->autoProxy) {
+		free(http->autoProxy);
+		http->autoProxy = NULL;
+	}
+	HttpProxyCacheClear (http);
+	HttpMutexUnlock(&http->proxyLock);
+
+	if (http->proxy) {
+		free(http->proxy);
+		http->proxy = NULL;
+	}
+
+	if (http->proxyUsername) {
+		free(http->proxyUsername);
+		http->proxyUsername = NULL;
+	}
+
+	if (http->proxyPassword) {
+		free(http->proxyPassword);
+		http->proxyPassword = NULL;
+	}
+}
+
+/*	drop all cached proxy decisions, proxyLock must be held
+ */
+static void HttpProxyCacheClear (http_t http) {
+	int i;
+
+	for (i = 0; i < HTTP_PROXY_CACHE_SIZE; ++i) {
+		HttpProxyCacheEntry_t* entry = &http->proxyCache[i];
+		free(entry->host);
+		free(entry->proxy);
+		free(entry->proxyBypass);
+		memset(entry, 0, sizeof(*entry));
+	}
+}
+
+/*	find cache entry for host, proxyLock must be held
+ *	@param http handle
+ *	@param host name
+ *	@param tls endpoint
+ *	@param create empty entry if there is none, evicting the one expiring
+ *		first if cache is full
+ *	@return entry or NULL
+ */
+static HttpProxyCacheEntry_t* HttpProxyCacheFind (http_t http,
+		const wchar_t* host, bool secure, bool create) {
+	HttpProxyCacheEntry_t* slot = NULL;
+	int i;
+
+	for (i = 0; i < HTTP_PROXY_CACHE_SIZE; ++i) {
+		HttpProxyCacheEntry_t* entry = &http->proxyCache[i];
+		if (!entry->host) {
+			if (!slot)
+				slot = entry;
+			continue;
+		}
+		if (entry->secure == secure && wcscmp(entry->host, host) == 0)
+			return entry;
+	}
+
+	if (!create)
+		return NULL;
+
+	if (!slot) {
+		slot = &http->proxyCache[0];
+		for (i = 1; i < HTTP_PROXY_CACHE_SIZE; ++i)
+			if (http->proxyCache[i].expires < slot->expires)
+				slot = &http->proxyCache[i];
+		free(slot->host);
+		free(slot->proxy);
+		free(slot->proxyBypass);
+		memset(slot, 0, sizeof(*slot));
+	}
+
+	slot->host = _wcsdup(host);
+	if (!slot->host)
+		return NULL;
+	slot->secure = secure;
+	return slot;
+}
+
+/*	run PAC script for host, may take a while, no locks must be held
+ *	@param http handle
+ *	@param PAC url
+ *	@param host name
+ *	@param tls endpoint
+ *	@param result, strings are to be freed with GlobalFree
+ *	@return true on success
+ */
+static bool HttpProxyEvaluate (http_t http, const wchar_t* autoProxy,
+		const wchar_t* host, bool secure, WINHTTP_PROXY_INFO* proxyInfo) {
+	WINHTTP_AUTOPROXY_OPTIONS proxyOptions = { 0 };
+	wchar_t url[512];
+
+	/* decision is cached per host, so evaluate for the host only */
+	_snwprintf(url, sizeof(url) / sizeof(*url) - 1, L"%ls://%ls/",
+		secure ? L"https" : L"http", host);
+	url[sizeof(url) / sizeof(*url) - 1] = 0;
+
+	proxyOptions.lpszAutoConfigUrl = (wchar_t*)autoProxy;
+	proxyOptions.dwFlags = WINHTTP_AUTOPROXY_CONFIG_URL;
+
+	memset(proxyInfo, 0, sizeof(*proxyInfo));
+	if (WinHttpGetProxyForUrl(http->session, url, &proxyOptions, proxyInfo))
+		return true;
+
+	proxyOptions.fAutoLogonIfChallenged = true;
+	return WinHttpGetProxyForUrl(http->session, url, &proxyOptions, proxyInfo) != FALSE;
+}
+
+/*	store PAC result in cache entry, proxyLock must be held
+ */
+static void HttpProxyCacheStore (HttpProxyCacheEntry_t* entry,
+		WINHTTP_PROXY_INFO* proxyInfo) {
+	free(entry->proxy);
+	free(entry->proxyBypass);
+	entry->accessType  = proxyInfo->dwAccessType;
+	entry->proxy       = proxyInfo->lpszProxy ? _wcsdup(proxyInfo->lpszProxy) : NULL;
+	entry->proxyBypass = proxyInfo->lpszProxyBypass ? _wcsdup(proxyInfo->lpszProxyBypass) : NULL;
+	entry->resolved    = true;
+	entry->expires     = HttpTickCount() + HTTP_PROXY_CACHE_TTL;
+}
+
+/*	re-evaluates PAC script for entries that are about to expire, takes
+ *	the script off the request path entirely once entries are primed
+ */
+static void HttpProxyRefresher (void* arg) {
+	http_t http = arg;
+
+	HttpMutexLock(&http->proxyLock);
+	while (!http->proxyRefresherQuit) {
+		const unsigned long long now = HttpTickCount();
+		unsigned long long wakeUp = now + HTTP_PROXY_CACHE_TTL;
+		HttpProxyCacheEntry_t* due = NULL;
+		int i;
+
+		for (i = 0; i < HTTP_PROXY_CACHE_SIZE; ++i) {
+			HttpProxyCacheEntry_t* entry = &http->proxyCache[i];
+			unsigned long long refreshAt;
+
+			if (!entry->host)
+				continue;
+
+			/* unresolved entries are due right away or, after a failure,
+			 * once the back-off in expires passed */
+			refreshAt = entry->resolved ?
+				entry->expires - HTTP_PROXY_CACHE_REFRESH : entry->expires;
+			if (refreshAt <= now) {
+				due = entry;
+				break;
+			}
+			if (refreshAt < wakeUp)
+				wakeUp = refreshAt;
+		}
+
+		if (due && http->autoProxy) {
+			WINHTTP_PROXY_INFO proxyInfo;
+			wchar_t* autoProxy = _wcsdup(http->autoProxy);
+			wchar_t* host = _wcsdup(due->host);
+			const bool secure = due->secure;
+			bool success = false;
+
+			HttpMutexUnlock(&http->proxyLock);
+			if (autoProxy && host)
+				success = HttpProxyEvaluate (http, autoProxy, host, secure, &proxyInfo);
+			HttpMutexLock(&http->proxyLock);
+
+			/* entry may be gone or reused meanwhile, look it up again */
+			if (success) {
+				if (http->autoProxy && autoProxy &&
+						wcscmp(http->autoProxy, autoProxy) == 0 &&
+						(due = HttpProxyCacheFind (http, host, secure, false)))
+					HttpProxyCacheStore (due, &proxyInfo);
+				if (proxyInfo.lpszProxy)
+					GlobalFree(proxyInfo.lpszProxy);
+				if (proxyInfo.lpszProxyBypass)
+					GlobalFree(proxyInfo.lpszProxyBypass);
+			}
+			else if ((due = HttpProxyCacheFind (http, host, secure, false))) {
+				/* keep serving what we have, try again later */
+				if (due->resolved)
+					due->expires += HTTP_PROXY_CACHE_REFRESH;
+				else
+					due->expires = HttpTickCount() + HTTP_PROXY_CACHE_REFRESH;
+			}
+
+			free(autoProxy);
+			free(host);
+			continue;
+		}
+
+		HttpCondWaitTimeout(&http->proxyWake, &http->proxyLock,
+			(unsigned int)(wakeUp > now ? wakeUp - now : 0));
+	}
+	HttpMutexUnlock(&http->proxyLock);
+}
+
+static void HttpProxyRefresherStop (http_t http) {
+	if (!http->proxyRefresherRunning)
+		return;
+
+	HttpMutexLock(&http->proxyLock);
+	http->proxyRefresherQuit = true;
+	HttpCondBroadcast(&http->proxyWake);
+	HttpMutexUnlock(&http->proxyLock);
+
+	HttpThreadJoin(http->proxyRefresher);
+	http->proxyRefresherRunning = false;
+	http->proxyRefresherQuit = false;
+}
+
+/*	apply proxy decision for request handle, PAC script is run here only if
+ *	the background refresher did not get to the host yet
+ */
+static bool HttpApplyAutoProxy (http_t http, HINTERNET handle, bool secure) {
+	HttpProxyCacheEntry_t* entry;
+	WINHTTP_PROXY_INFO proxyInfo;
+	bool success;
+
+	HttpMutexLock(&http->proxyLock);
+	entry = HttpProxyCacheFind (http, http->endpoint, secure, true);
+	if (entry && (!entry->resolved || entry->expires <= HttpTickCount())) {
+		wchar_t* autoProxy = _wcsdup(http->autoProxy);
+
+		HttpMutexUnlock(&http->proxyLock);
+		success = autoProxy &&
+			HttpProxyEvaluate (http, autoProxy, http->endpoint, secure, &proxyInfo);
+		free(autoProxy);
+		if (!success)
+			return false;
+		HttpMutexLock(&http->proxyLock);
+
+		entry = HttpProxyCacheFind (http, http->endpoint, secure, true);
+		if (entry)
+			HttpProxyCacheStore (entry, &proxyInfo);
+		if (proxyInfo.lpszProxy)
+			GlobalFree(proxyInfo.lpszProxy);
+		if (proxyInfo.lpszProxyBypass)
+			GlobalFree(proxyInfo.lpszProxyBypass);
+
+		/* make sure refresher knows about new entry */
+		HttpCondBroadcast(&http->proxyWake);
+	}
+
+	if (!entry) {
+		HttpMutexUnlock(&http->proxyLock);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return false;
+	}
+
+	proxyInfo.dwAccessType    = entry->accessType;
+	proxyInfo.lpszProxy       = entry->proxy;
+	proxyInfo.lpszProxyBypass = entry->proxyBypass;
+
+	/* WinHTTP copies the strings */
+	success = WinHttpSetOption(handle, WINHTTP_OPTION_PROXY, &proxyInfo,
+		sizeof(proxyInfo)) != FALSE;
+	HttpMutexUnlock(&http->proxyLock);
+
+	return success;
+}
+
+static bool HttpWinSetAutoProxy (http_t http, const char* url) {
+	wchar_t* autoProxy;
+
+	HttpClearProxy (http);
+	if (!HttpWinSetProxy (http, url))
+		return false;
+
+	/* PAC script is fetched from full url, keep path and scheme */
+	autoProxy = HttpToWideString(url, -1);
+	if (!autoProxy)
+		return false;
+
+	HttpMutexLock(&http->proxyLock);
+	http->autoProxy = autoProxy;
+	free(http->proxy);
+	http->proxy = NULL;
+
+	/* prime cache in background, first requests are made right away */
+	HttpProxyCacheFind (http, http->endpoint, true, true);
+	HttpProxyCacheFind (http, http->endpoint, false, true);
+
+	if (!http->proxyRefresherRunning)
+		http->proxyRefresherRunning = HttpThreadCreate(&http->proxyRefresher,
+			HttpProxyRefresher, http);
+	HttpCondBroadcast(&http->proxyWake);
+	HttpMutexUnlock(&http->proxyLock);
+
+	return true;
+}
+
+static void HttpWinSetCompression (http_t http, bool enabled) {
+	http->compression = enabled;
+}
+
+static void HttpUrlDecodeInplace (wchar_t* url)
+{
+	wchar_t* input = url;
+	wchar_t* output = url;
+	size_t size = wcslen (url);
+	while (size > 0) {
+		if (input[0] == '%' && iswxdigit(input[1]) && iswxdigit(input[2])) {
+			wchar_t hex[3];
+			hex[0] = input[1];
+			hex[1] = input[2];
+			hex[2] = 0;
+			*output++ = (wchar_t)(wcstol (hex, NULL, 16));
+			input += 3;
+			size -= 3;
+		}
+		else {
+			*output++ = *input++;
+			--size;
+		}
+	}
+
+	if (output < input) {
+		*output = '\0';
+	}
+}
+
+static bool HttpWinSetProxy (http_t http, const char* url) {
+	URL_COMPONENTS urlComponents;
+	wchar_t* wideUrl = NULL;
+	wchar_t* wideUrl2 = NULL;
+	wchar_t* wideUsername = NULL;
+	wchar_t* widePassword = NULL;
+
+	ZeroMemory(&urlComponents, sizeof(urlComponents));
+	urlComponents.dwStructSize      = sizeof(urlComponents);
+	urlComponents.dwUserNameLength = -1;
+	urlComponents.dwPasswordLength = -1;
+
+	wideUrl = HttpToWideString(url, -1);
+	if (WinHttpCrackUrl(wideUrl, (DWORD)wcslen(wideUrl), 0, &urlComponents)) {
+		if (urlComponents.lpszUserName && urlComponents.dwUserNameLength > 0) {
+			wideUsername = wcsdup(urlComponents.lpszUserName);
+			wideUsername[urlComponents.dwUserNameLength] = 0;
+			HttpUrlDecodeInplace (wideUsername);
+		}
+		if (urlComponents.lpszPassword && urlComponents.dwPasswordLength > 0) {
+			widePassword = wcsdup(urlComponents.lpszPassword);
+			widePassword[urlComponents.dwPasswordLength] = 0;
+			HttpUrlDecodeInplace (widePassword);
+		}
+	}
+
+	ZeroMemory(&urlComponents, sizeof(urlComponents));
+	urlComponents.dwStructSize = sizeof(urlComponents);
+	urlComponents.dwHostNameLength  = -1;
+	urlComponents.dwUrlPathLength   = -1;
+
+	if (!WinHttpCrackUrl(wideUrl, (DWORD)wcslen(wideUrl), 0, &urlComponents)) {
+		free(wideUsername);
+		free(widePassword);
+		return false;
+	}
+
+	if (urlComponents.lpszHostName && urlComponents.dwHostNameLength > 0) {
+		wideUrl2 = wcsdup(urlComponents.lpszHostName);
+		wideUrl2[urlComponents.lpszUrlPath - urlComponents.lpszHostName] = 0;
+	}
+
+	free(wideUrl);
+
+	HttpClearProxy(http);
+	http->proxy         = wideUrl2;
+	http->proxyUsername = wideUsername;
+	http->proxyPassword = widePassword;
+	return true;
+}
+
+/*	read Retry-After header, only the delay-seconds form is understood
+ */
+static unsigned int HttpGetRetryAfter (HINTERNET handle) {
+	DWORD seconds = 0;
+	DWORD secondsSize = sizeof(seconds);
+
+	if (!WinHttpQueryHeaders(handle,
+			WINHTTP_QUERY_RETRY_AFTER | WINHTTP_QUERY_FLAG_NUMBER,
+			WINHTTP_HEADER_NAME_BY_INDEX,
+			&seconds, &secondsSize, WINHTTP_NO_HEADER_INDEX))
+		return 0;
+
+	return seconds;
+}
+
+static http_status HttpWinRequest(http_t http, PianoRequest_t * const request,
+		http_buffer* response, unsigned int* retryAfter,
+		http_metrics* metrics) {
+	HINTERNET connection = NULL;
+	HINTERNET handle = NULL;
+	wchar_t* wideQuery = NULL;
+	bool requestSent = false;
+	http_status result = HTTP_STATUS_FATAL;
+	/* resends WinHTTP asks for as part of the protocol (proxy
+	 * authentication), failures are retried by the dispatcher */
+	int resendLimit = 3;
+	DWORD contentLength, contentLengthSize;
+	bool hasContentLength, poolKnown, newConnection;
+	unsigned long long sendTime = 0, waitTime = 0, bodyStarted;
+
+	wideQuery = HttpToWideString(request->urlPath, -1);
+	WINHTTP_SAFE_DONE(wideQuery != NULL);
+
+	connection = HttpGetConnection (http, request->secure);
+	WINHTTP_SAFE_DONE(connection != NULL);
+
+	handle = WinHttpOpenRequest(
+		connection,
+		L"POST",
+		wideQuery,
+		L"HTTP/1.1",
+		WINHTTP_NO_REFERER,
+		WINHTTP_DEFAULT_ACCEPT_TYPES,
+		request->secure ? WINHTTP_FLAG_SECURE : 0);
+	WINHTTP_SAFE_DONE(handle != NULL);
+
+#ifdef WINHTTP_OPTION_DECOMPRESSION
+	if (http->compression) {
+		/* WinHTTP adds Accept-Encoding and inflates while the body is read;
+		 * the option is missing before Windows 8.1, which then simply gets
+		 * uncompressed responses */
+		DWORD decompression = WINHTTP_DECOMPRESSION_FLAG_ALL;
+		WinHttpSetOption(handle, WINHTTP_OPTION_DECOMPRESSION,
+			&decompression, sizeof(decompression));
+	}
+#endif
+
+	if (http->proxy || http->autoProxy) {
+		if (http->autoProxy) {
+			WINHTTP_SAFE_DONE(HttpApplyAutoProxy (http, handle, request->secure));
+		}
+		else {
+			WINHTTP_PROXY_INFO proxyInfo;
+			proxyInfo.dwAccessType    = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
+			proxyInfo.lpszProxy       = http->proxy;
+			proxyInfo.lpszProxyBypass = NULL;
+
+			WINHTTP_SAFE_DONE(WinHttpSetOption(handle,
+				WINHTTP_OPTION_PROXY,
+				&proxyInfo, sizeof(proxyInfo)));
+		}
+
+		if (http->proxyUsername && http->proxyPassword) {
+			WINHTTP_SAFE_DONE(WinHttpSetCredentials(handle,
+				WINHTTP_AUTH_TARGET_PROXY,
+				WINHTTP_AUTH_SCHEME_BASIC,
+				http->proxyUsername,
+				http->proxyPassword,
+				NULL));
+		}
+	}
+
+	for (;;) {
+		DWORD errorCode, statusCode, statusCodeSize;
+		bool succeeded = false;
+
+		if (resendLimit-- == 0) {
+			/* error of last attempt is kept */
+			goto done;
+		}
+
+		if (!requestSent) {
+			size_t postDataSize = strlen(request->postData);
+			const unsigned long long sendStarted = HttpMicroseconds();
+			succeeded = WinHttpSendRequest(handle,
+				WINHTTP_NO_ADDITIONAL_HEADERS,
+				0,
+				request->postData,
+				(DWORD)postDataSize,
+				(DWORD)postDataSize,
+				0);
+			sendTime += HttpMicroseconds() - sendStarted;
+
+			if (succeeded)
+				requestSent = true;
+		}
+
+		if (requestSent) {
+			const unsigned long long waitStarted = HttpMicroseconds();
+			succeeded = WinHttpReceiveResponse(handle, NULL);
+			waitTime += HttpMicroseconds() - waitStarted;
+		}
+
+		errorCode = succeeded ? ERROR_SUCCESS : GetLastError();
+
+		statusCode = 0;
+		statusCodeSize = sizeof(statusCode);
+		if (!WinHttpQueryHeaders(handle,
+				WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+				WINHTTP_HEADER_NAME_BY_INDEX,
+				&statusCode, &statusCodeSize, WINHTTP_NO_HEADER_INDEX)) {
+			statusCode = 0;
+		}
+
+		if (succeeded && (statusCode == 407 || statusCode == 429 ||
+				(statusCode >= 500 && statusCode <= 599))) {
+			wchar_t statusText[256] = { 0 };
+			DWORD statusTextSize = sizeof(statusText) - 1;
+			WinHttpQueryHeaders(handle,
+				WINHTTP_QUERY_STATUS_TEXT,
+				WINHTTP_HEADER_NAME_BY_INDEX,
+				statusText, &statusTextSize, WINHTTP_NO_HEADER_INDEX);
+			HttpSetLastErrorW (http, statusText);
+
+			if (statusCode == 407) {
+				/* send again, now with proxy credentials */
+				requestSent = false;
+				continue;
+			}
+
+			*retryAfter = HttpGetRetryAfter (handle);
+			result = HTTP_STATUS_TRANSIENT;
+			goto done;
+		}
+
+		if (succeeded)
+			break;
+
+		switch (errorCode) {
+			case ERROR_WINHTTP_RESEND_REQUEST:
+				requestSent = false;
+				continue;
+
+			case ERROR_WINHTTP_NAME_NOT_RESOLVED:
+				if (http->resolver)
+					HttpResolverInvalidate (http->resolver);
+				/* pass through */
+
+			case ERROR_WINHTTP_CANNOT_CONNECT:
+			case ERROR_WINHTTP_CONNECTION_ERROR:
+			case ERROR_WINHTTP_TIMEOUT:
+				result = HTTP_STATUS_TRANSIENT;
+				/* pass through */
+
+			default:
+				SetLastError(errorCode);
+				HttpSetLastErrorFromWinHttp (http);
+				goto done;
+		}
+	}
+
+	/* size buffer up front if server told us how much is coming */
+	contentLength = 0;
+	contentLengthSize = sizeof(contentLength);
+	hasContentLength = WinHttpQueryHeaders(handle,
+			WINHTTP_QUERY_CONTENT_LENGTH | WINHTTP_QUERY_FLAG_NUMBER,
+			WINHTTP_HEADER_NAME_BY_INDEX,
+			&contentLength, &contentLengthSize, WINHTTP_NO_HEADER_INDEX) != FALSE;
+	if (hasContentLength && !HttpBufferReserve(response, contentLength)) {
+		HttpSetLastError (http, "Out of memory");
+		goto done;
+	}
+
+	bodyStarted = HttpMicroseconds();
+
+	for (;;)
+	{
+		DWORD bytesLeft;
+		char* writePtr;
+
+		DWORD bytesAvailable = 0;
+		if (!WinHttpQueryDataAvailable(handle, &bytesAvailable))
+			goto readFailed;
+
+		if (0 == bytesAvailable)
+			break;
+
+		if (!HttpBufferReserve(response,
+				response->size + bytesAvailable)) {
+			HttpSetLastError (http, "Out of memory");
+			goto done;
+		}
+
+		/* read straight into the buffer, no intermediate copy */
+		writePtr = response->data + response->size;
+
+		bytesLeft = bytesAvailable;
+		while (bytesLeft > 0)
+		{
+			DWORD bytesRead = 0;
+			if (!WinHttpReadData(handle, writePtr, bytesLeft, &bytesRead))
+				goto readFailed;
+
+			bytesLeft -= bytesRead;
+			writePtr  += bytesRead;
+			HttpBufferCommit (response, bytesRead);
+		}
+	}
+
+	result = HTTP_STATUS_OK;
+
+	metrics->phase[HTTP_PHASE_BODY] = HttpMicroseconds() - bodyStarted;
+	metrics->phase[HTTP_PHASE_WAIT] = waitTime;
+
+	poolKnown = HttpUpdatePoolStats (http, handle, &newConnection);
+	if (!HttpUpdatePhases (handle, metrics)) {
+		/* name resolution, connect and tls handshake happen inside
+		 * WinHttpSendRequest and cannot be told apart without WinHTTP's
+		 * timestamps */
+		if (poolKnown && !newConnection) {
+			metrics->phase[HTTP_PHASE_SEND] = sendTime;
+		}
+		else {
+			metrics->phase[HTTP_PHASE_DNS]     = HTTP_PHASE_UNKNOWN;
+			metrics->phase[HTTP_PHASE_CONNECT] = HTTP_PHASE_UNKNOWN;
+			metrics->phase[HTTP_PHASE_TLS]     = HTTP_PHASE_UNKNOWN;
+			metrics->phase[HTTP_PHASE_SEND]    = HTTP_PHASE_UNKNOWN;
+		}
+	}
+
+	/* Content-Length is the size on the wire, encoded or not; chunked
+	 * responses do not tell and are counted as decoded */
+	metrics->bytesSent     = strlen(request->postData);
+	metrics->bytesReceived = hasContentLength ? contentLength : response->size;
+
+	HttpSetLastError (http, NULL);
+	goto done;
+
+readFailed:
+	/* body is incomplete, whole request has to be repeated */
+	switch (GetLastError()) {
+		case ERROR_WINHTTP_TIMEOUT:
+		case ERROR_WINHTTP_CONNECTION_ERROR:
+			result = HTTP_STATUS_TRANSIENT;
+			break;
+	}
+	HttpSetLastErrorFromWinHttp (http);
+
+done:
+	if (handle)
+		WinHttpCloseHandle(handle);
+	free(wideQuery);
+	return result;
+}
+
+static const char* HttpWinGetError(http_t http) {
+	return http->error;
+}
+
+http_iface http_winhttp =
+{
+	.Id				= "winhttp",
+	.Name			= "Windows HTTP Services",
+	.Create			= HttpWinCreate,
+	.Destroy		= HttpWinDestroy,
+	.SetAutoProxy	= HttpWinSetAutoProxy,
+	.SetProxy		= HttpWinSetProxy,
+	.SetCompression	= HttpWinSetCompression,
+	.Request		= HttpWinRequest,
+	.GetError		= HttpWinGetError
+};
+
+#endif /* _WIN32 */
@@ -21,523 +21,1353 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
+/* dispatch http requests to one of the available backends */
+
 #include "config.h"
-#include "http.h"
-#include <Windows.h>
-#include <winhttp.h>
-#pragma comment(lib, "winhttp.lib")
+#include "http_private.h"
+#include "http_resolver.h"
+#include "http_thread.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* answers of read-only requests kept at most, and for how long by default
+ * (milliseconds) */
+#define HTTP_CACHE_SIZE	16
+#define HTTP_CACHE_TTL	(30 * 1000)
+
+static http_iface* http_backends[] =
+{
+#ifdef _WIN32
+	&http_winhttp,
+#endif
+#ifdef HAVE_LIBCURL
+	&http_curl,
+#endif
+	/* never picked by default, needs a replay file */
+	&http_replay,
+	NULL
+};
+
+/* request queued with HttpRequestAsync */
+typedef struct _http_job {
+	struct _http_job*	next;
+	PianoRequest_t*		request;
+	HttpCallback_t		callback;
+	void*				userData;
+	/* jobs of the same HttpBatchBegin/End pair share this, 0 if none */
+	unsigned int		batch;
+	http_buffer			response;
+	bool				succeeded;
+	char*				error;
+} http_job;
+
+typedef struct {
+	http_job*		first;
+	http_job*		last;
+} http_job_queue;
+
+/* answer of read-only request, see PianoRequest_t.cacheKey */
+typedef struct {
+	char*				key;
+	char*				data;
+	size_t				size;
+	unsigned long long	expires;
+} http_cache_entry;
 
 struct _http_t {
-	HINTERNET		session;
-	HINTERNET		connection;
-	wchar_t*		endpoint;
-	wchar_t*		securePort;
-	wchar_t*		autoProxy;
-	wchar_t*		proxy;
-	wchar_t*		proxyUsername;
-	wchar_t*		proxyPassword;
+	http_iface*		backend;
+	http_t			http;
+	HttpStats_t		stats;
+	/* looks up the rpc host off the request path, may be NULL */
+	http_resolver*	resolver;
+	/* indexed by request type, guarded by backendLock */
+	HttpRequestStats_t	requestStats[HTTP_REQUEST_TYPES];
+	http_buffer		response;
+	/* error of last synchronous call, worker may overwrite backend's one */
 	char*			error;
+
+	/* retry state, guarded by backendLock */
+	HttpRetryPolicy_t	retry;
+	unsigned int	consecutiveFailures;
+	unsigned long long	breakerOpenUntil;
+	unsigned int	jitterState;
+
+	/* answers of read-only requests, guarded by backendLock */
+	http_cache_entry	cache[HTTP_CACHE_SIZE];
+	/* milliseconds, 0 disables the cache */
+	unsigned int	cacheTtl;
+
+	/* backends are not reentrant, serializes sync and async requests */
+	http_mutex		backendLock;
+	/* successful requests are appended here, guarded by backendLock */
+	FILE*			record;
+
+	/* guards everything below */
+	http_mutex		queueLock;
+	http_cond		queueChanged;
+	http_thread		worker;
+	bool			workerRunning;
+	bool			workerQuit;
+	http_job_queue	submitted;
+	http_job_queue	completed;
+	/* jobs of an open batch, submitted all at once by HttpBatchEnd */
+	http_job_queue	staged;
+	unsigned int	batchDepth;
+	unsigned int	batchSerial;
+	/* jobs submitted, but not yet handed back by HttpPoll */
+	size_t			pending;
+	/* worker is inside backend right now */
+	bool			busy;
 };
 
-static char* HttpToString(const wchar_t* wideString, size_t size);
-static wchar_t* HttpToWideString(const char* string, size_t size);
-static bool HttpCreateConnection (http_t http, unsigned int timeOut);
-static void HttpCloseConnection (http_t http);
-static void HttpSetLastError (http_t http, const char* message);
-static void HttpSetLastErrorW (http_t http, const wchar_t* message);
-static void HttpSetLastErrorFromWinHttp (http_t http);
-static char* HttpFormatWinApiError (DWORD errorCode, HINSTANCE module);
-static char* HttpFormatWinHttpError (DWORD errorCode);
-static void HttpClearProxy (http_t http);
-
-# define WINHTTP_SAFE(condition) do { if (condition) break; HttpSetLastErrorFromWinHttp (http); return false; } while (false)
-# define WINHTTP_SAFE_DONE(condition) do { if (condition) break; HttpSetLastErrorFromWinHttp (http); goto done; } while (false)
-
-static char* HttpToString(const wchar_t* wideString, size_t size) {
-	int utfSize = WideCharToMultiByte(CP_UTF8, 0, wideString, (int)size, NULL, 0, NULL, NULL);
-	char* utfMessage = malloc(utfSize + 1);
-	if (utfMessage)	{
-		utfMessage[utfSize] = 0;
-		WideCharToMultiByte(CP_UTF8, 0, wideString, (int)size, utfMessage, utfSize, NULL, NULL);
-	}
-	return utfMessage;
+static void HttpJobQueuePush (http_job_queue* queue, http_job* job) {
+	job->next = NULL;
+	if (queue->last)
+		queue->last->next = job;
+	else
+		queue->first = job;
+	queue->last = job;
 }
 
-static wchar_t* HttpToWideString(const char* string, size_t size) {
-	int wideSize = MultiByteToWideChar(CP_UTF8, 0, string, (int)size, NULL, 0);
-	int wideBytes = (wideSize + 1) * sizeof(wchar_t);
-	wchar_t* wideMessage = malloc(wideBytes);
-	if (wideMessage) {
-		wideMessage[wideSize] = 0;
-		MultiByteToWideChar(CP_UTF8, 0, string, (int)size, wideMessage, wideSize);
+static http_job* HttpJobQueuePop (http_job_queue* queue) {
+	http_job* job = queue->first;
+	if (job) {
+		queue->first = job->next;
+		if (!queue->first)
+			queue->last = NULL;
+		job->next = NULL;
 	}
-	return wideMessage;
+	return job;
 }
 
+static void HttpJobFree (http_job* job) {
+	HttpBufferFree(&job->response);
+	free(job->error);
+	free(job);
+}
 
-static bool HttpCreateConnection (http_t http, unsigned int timeOut) {
-	INTERNET_PORT defaultPort = INTERNET_DEFAULT_PORT;
+/*	number of attempts allowed for request type
+ */
+static unsigned int HttpRetryAttempts (http_t http, PianoRequestType_t type) {
+	unsigned int attempts = 0;
 
-	HttpCloseConnection (http);
+	if ((unsigned int)type < HTTP_REQUEST_TYPES)
+		attempts = http->retry.attempts[type];
+	if (attempts == 0)
+		attempts = http->retry.defaultAttempts;
 
-	http->session = WinHttpOpen(
-		L"WinHTTP/1.0",
-		WINHTTP_ACCESS_TYPE_NO_PROXY,
-		WINHTTP_NO_PROXY_NAME,
-		WINHTTP_NO_PROXY_BYPASS,
-		0);
-	WINHTTP_SAFE(http->session != NULL);
+	return attempts > 0 ? attempts : 1;
+}
 
-	WinHttpSetTimeouts(http->session,
-		timeOut * 1000,  // DNS time-out
-		timeOut * 1000,  // connect time-out
-		timeOut * 1000,  // send time-out
-		timeOut * 1000); // receive time-out
+/*	backoff before given retry, random in [0, min(maxDelay, base * 2^n))
+ *	so clients that failed together do not come back together
+ */
+static unsigned int HttpRetryDelay (http_t http, unsigned int attempt) {
+	unsigned long long ceiling = http->retry.baseDelay;
+	unsigned int x;
+
+	while (--attempt > 0 && ceiling < http->retry.maxDelay)
+		ceiling *= 2;
+	if (ceiling > http->retry.maxDelay)
+		ceiling = http->retry.maxDelay;
+	if (ceiling == 0)
+		return 0;
+
+	/* xorshift32, good enough for jitter */
+	x = http->jitterState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	http->jitterState = x;
+
+	return (unsigned int)(x % ceiling);
+}
 
-	http->connection = WinHttpConnect(
-		http->session,
-		http->endpoint,
-		defaultPort,
-		0);
-	WINHTTP_SAFE(http->connection != NULL);
+static void HttpHistogramAdd (HttpHistogram_t* histogram,
+		unsigned long long microseconds) {
+	unsigned long long milliseconds = microseconds / 1000;
+	int bucket = 0;
 
-	return true;
+	if (microseconds == HTTP_PHASE_UNKNOWN) {
+		++histogram->unknown;
+		return;
+	}
+
+	while (milliseconds > 0 && bucket < HTTP_HISTOGRAM_BUCKETS - 1) {
+		milliseconds >>= 1;
+		++bucket;
+	}
+
+	++histogram->count[bucket];
+	histogram->sum += microseconds;
+	if (microseconds > histogram->max)
+		histogram->max = microseconds;
 }
 
-static void HttpCloseConnection (http_t http) {
-	if (http->connection) {
-		WinHttpCloseHandle(http->connection);
-		http->connection = NULL;
+/*	account successful attempt, backendLock must be held
+ *	@param http handle
+ *	@param request
+ *	@param measurements of the attempt, total included
+ *	@param decoded response size
+ */
+static void HttpUpdateRequestStats (http_t http, const PianoRequest_t* request,
+		const http_metrics* metrics, size_t decoded) {
+	HttpRequestStats_t* stats;
+	int i;
+
+	http->stats.bytesReceived += metrics->bytesReceived;
+	http->stats.bytesDecoded  += decoded;
+
+	if ((unsigned int)request->type >= HTTP_REQUEST_TYPES)
+		return;
+
+	stats = &http->requestStats[request->type];
+	++stats->requests;
+	stats->bytesSent     += metrics->bytesSent;
+	stats->bytesReceived += metrics->bytesReceived;
+	stats->bytesDecoded  += decoded;
+	for (i = 0; i < HTTP_PHASE_COUNT; ++i)
+		HttpHistogramAdd(&stats->phase[i], metrics->phase[i]);
+}
+
+/*	overwrite every value following key with 'x', keeps the size so the
+ *	replayed client still finds a token to send back
+ *	@param NUL-terminated text, changed in place
+ *	@param key, including everything up to the value
+ *	@param characters that end the value
+ */
+static void HttpRecordRedact (char* text, const char* key, const char* end) {
+	char* value = text;
+
+	while ((value = strstr(value, key))) {
+		value += strlen(key);
+		while (*value != '\0' && !strchr(end, *value))
+			*value++ = 'x';
 	}
+}
 
-	if (http->session) {
-		WinHttpCloseHandle(http->session);
-		http->session = NULL;
+/*	append successful request to record file, format is described along
+ *	with HTTP_RECORD_MAGIC; the login and auth tokens are kept out of it
+ *	@param http handle
+ *	@param request
+ *	@param response body
+ *	@param milliseconds the successful attempt took
+ */
+static void HttpRecord (http_t http, const PianoRequest_t* request,
+		const http_buffer* response, unsigned int latency) {
+	char* urlPath = strdup(request->urlPath);
+	char* data = malloc(response->size + 1);
+	size_t urlPathSize;
+
+	if (!urlPath || !data) {
+		free(urlPath);
+		free(data);
+		return;
 	}
+	memcpy(data, response->data, response->size);
+	data[response->size] = '\0';
+
+	HttpRecordRedact(urlPath, "auth_token=", "&");
+	/* pandora sends compact json */
+	HttpRecordRedact(data, "\"partnerAuthToken\":\"", "\"");
+	HttpRecordRedact(data, "\"userAuthToken\":\"", "\"");
+	urlPathSize = strlen(urlPath);
+
+	/* request body is encrypted with the well known partner key only and
+	 * holds username, password or tokens; replay does not need it */
+	fprintf(http->record, "%d %u %lu %lu %lu\n", (int)request->type, latency,
+		(unsigned long)urlPathSize, 0ul, (unsigned long)response->size);
+	fwrite(urlPath, 1, urlPathSize, http->record);
+	fwrite(data, 1, response->size, http->record);
+	fputc('\n', http->record);
+	/* keep file usable if pianobar does not exit cleanly */
+	fflush(http->record);
+
+	free(urlPath);
+	free(data);
 }
 
-static void HttpSetLastError (http_t http, const char* message) {
-	free(http->error);
-	http->error = NULL;
+/*	drop all cached answers, backendLock held
+ */
+static void HttpCacheClear (http_t http) {
+	size_t i;
 
-	if (message)
-		http->error = strdup(message);
+	for (i = 0; i < HTTP_CACHE_SIZE; ++i) {
+		free(http->cache[i].key);
+		free(http->cache[i].data);
+	}
+	memset(http->cache, 0, sizeof(http->cache));
 }
 
-static void HttpSetLastErrorW (http_t http, const wchar_t* message) {
-	free(http->error);
-	http->error = NULL;
+/*	tells whether answer reports "stat":"ok", errors like an expired auth
+ *	token come with http status 200 too and must not be cached
+ *	@param response body, NUL-terminated
+ */
+static bool HttpAnswerOk (const http_buffer* response) {
+	const char* p;
 
-	if (message)
-		http->error = HttpToString(message, wcslen(message));
-}
+	if (!response->data)
+		return false;
 
-static void HttpSetLastErrorFromWinHttp (http_t http) {
-	free(http->error);
-	http->error = NULL;
+	p = strstr(response->data, "\"stat\"");
+	if (!p)
+		return false;
+	p += strlen("\"stat\"");
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		++p;
+	if (*p++ != ':')
+		return false;
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		++p;
 
-	DWORD error = GetLastError();
-	if (error)
-		http->error = HttpFormatWinHttpError(error);
+	return strncmp(p, "\"ok\"", 4) == 0;
 }
 
-static char* HttpFormatWinApiError (DWORD errorCode, HINSTANCE module) {
-	const int source_flag = module ? FORMAT_MESSAGE_FROM_HMODULE : FORMAT_MESSAGE_FROM_SYSTEM;
+/*	keep answer of read-only request for cacheTtl, replacing the entry that
+ *	expires first if there is no room
+ */
+static void HttpCacheStore (http_t http, const PianoRequest_t* request,
+		const http_buffer* response) {
+	http_cache_entry* entry = NULL;
+	char* key;
+	char* data;
+	size_t i;
+
+	for (i = 0; i < HTTP_CACHE_SIZE; ++i) {
+		http_cache_entry* candidate = &http->cache[i];
+
+		if (candidate->key && strcmp(candidate->key, request->cacheKey) == 0) {
+			entry = candidate;
+			break;
+		}
+		if (!entry || (entry->key && (!candidate->key ||
+				candidate->expires < entry->expires)))
+			entry = candidate;
+	}
 
-	HLOCAL buffer = NULL;
-	int bufferLength = FormatMessageW(
-		FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_IGNORE_INSERTS | source_flag,
-		(void*)module,
-		errorCode,
-		MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-		(LPWSTR)&buffer,
-		0,
-		NULL);
+	key  = strdup(request->cacheKey);
+	data = malloc(response->size + 1);
+	if (!key || !data) {
+		free(key);
+		free(data);
+		return;
+	}
+	memcpy(data, response->data, response->size);
+	data[response->size] = '\0';
+
+	free(entry->key);
+	free(entry->data);
+	entry->key     = key;
+	entry->data    = data;
+	entry->size    = response->size;
+	entry->expires = HttpTickCount() + http->cacheTtl;
+}
+
+/*	answer read-only request from cache, backendLock held
+ *	@return true if response was filled in
+ */
+static bool HttpCacheServe (http_t http, PianoRequest_t * const request,
+		http_buffer* response) {
+	const unsigned long long now = HttpTickCount();
+	size_t i;
 
-	if (bufferLength > 0) {
-		char* message;
+	if (!request->cacheKey || http->cacheTtl == 0)
+		return false;
 
-		wchar_t* wideMessage = (wchar_t*)buffer;
+	for (i = 0; i < HTTP_CACHE_SIZE; ++i) {
+		const http_cache_entry* entry = &http->cache[i];
 
-		/* Drop new line from the end. */
-		wchar_t* wideMessageBack = wideMessage + bufferLength - 1;
-		while (wideMessageBack > wideMessage && (*wideMessageBack == '\r' || *wideMessageBack == '\n'))
-			--wideMessageBack;
+		if (!entry->key || strcmp(entry->key, request->cacheKey) != 0)
+			continue;
 
-		message = HttpToString (wideMessage, wideMessageBack - wideMessage + 1);
+		if (now >= entry->expires)
+			break;
 
-		LocalFree(buffer);
+		HttpBufferClear(response);
+		if (!HttpBufferAppend(response, entry->data, entry->size) ||
+				!HttpBufferReserve(response, 0))
+			break;
 
-		return message;
+		++http->stats.cacheHits;
+		request->responseData = response->data;
+		request->responseDataSize = response->size;
+		return true;
 	}
-	else
-		return NULL;
+
+	++http->stats.cacheMisses;
+	return false;
 }
 
-static char* HttpFormatWinHttpError (DWORD errorCode) {
-	if (errorCode >= WINHTTP_ERROR_BASE && errorCode <= WINHTTP_ERROR_LAST) {
-		HMODULE module = GetModuleHandleW(L"WinHTTP.dll");
-		if (module) {
-			char* message = HttpFormatWinApiError(errorCode, module);
-			if (message)
-				return message;
-		}
+/*	bookkeeping for successful attempt, backendLock held
+ */
+static void HttpSucceeded (http_t http, PianoRequest_t * const request,
+		http_buffer* response, const http_metrics* metrics) {
+	http->consecutiveFailures = 0;
+	HttpUpdateRequestStats(http, request, metrics, response->size);
+	if (http->record)
+		HttpRecord(http, request, response,
+			(unsigned int)(metrics->phase[HTTP_PHASE_TOTAL] / 1000));
+
+	if (request->cacheKey) {
+		if (http->cacheTtl > 0 && HttpAnswerOk(response))
+			HttpCacheStore(http, request, response);
 	}
+	else if (request->type != PIANO_REQUEST_GET_PLAYLIST)
+		/* may have changed what cached answers say, login in particular
+		 * renews the auth token earlier answers were fetched with */
+		HttpCacheClear(http);
 
-	return HttpFormatWinApiError(errorCode, NULL);
+	request->responseData = response->data;
+	request->responseDataSize = response->size;
 }
 
-bool HttpInit(http_t* http, const char* endpoint, const char* securePort, unsigned int timeOut) {
-	http_t out = malloc(sizeof(struct _http_t));
-	if (!out)
+/*	account failed attempt and decide whether to try again, backendLock held
+ *	@param http handle
+ *	@param status of the attempt
+ *	@param attempt number, starting at 1
+ *	@param attempts allowed
+ *	@param seconds server asked to wait, 0 if it did not
+ *	@param how long to wait before the next attempt (milliseconds)
+ *	@return true if request should be repeated
+ */
+static bool HttpShouldRetry (http_t http, http_status status,
+		unsigned int attempt, unsigned int attempts, unsigned int retryAfter,
+		unsigned int* delay) {
+	if (status != HTTP_STATUS_TRANSIENT)
 		return false;
-	memset(out, 0, sizeof(struct _http_t));
 
-	out->endpoint   = HttpToWideString(endpoint, -1);
-	out->securePort = HttpToWideString(securePort, -1);
+	if (http->retry.breakerThreshold > 0 &&
+			++http->consecutiveFailures >= http->retry.breakerThreshold) {
+		http->breakerOpenUntil = HttpTickCount() + http->retry.breakerCooldown;
+		++http->stats.breakerTrips;
+		return false;
+	}
 
-	if (!HttpCreateConnection (out, timeOut)) {
-		HttpDestroy (out);
+	if (attempt >= attempts)
 		return false;
+
+	*delay = HttpRetryDelay(http, attempt);
+	if (retryAfter > 0) {
+		/* server knows better, but do not wait longer than allowed */
+		if (retryAfter * 1000u > http->retry.maxDelay)
+			return false;
+		if (retryAfter * 1000u > *delay)
+			*delay = retryAfter * 1000u;
 	}
 
-	*http = out;
+	++http->stats.retries;
 	return true;
 }
 
-void HttpDestroy(http_t http) {
-	if (http) {
-		free(http->endpoint);
-		free(http->securePort);
-		http->endpoint = NULL;
-		http->securePort = NULL;
-		HttpCloseConnection (http);
-		HttpClearProxy (http);
+/*	run backend request into given buffer according to retry policy,
+ *	holding the backend lock
+ *	@param http handle
+ *	@param request
+ *	@param response body goes here
+ *	@param copy of the error message on failure, NULL otherwise
+ *	@param attempts already spent on this request elsewhere
+ *	@return true on success
+ */
+static bool HttpPerform (http_t http, PianoRequest_t * const request,
+		http_buffer* response, char** error, unsigned int used) {
+	const char* message = NULL;
+	unsigned int attempts, attempt;
+	http_status status = HTTP_STATUS_FATAL;
+
+	HttpMutexLock(&http->backendLock);
+
+	response->request = request;
+
+	/* identical request that waited for the lock finds the answer of the
+	 * one before it here */
+	if (HttpCacheServe(http, request, response)) {
+		*error = NULL;
+		HttpMutexUnlock(&http->backendLock);
+		return true;
 	}
-	free(http);
-}
 
-static void HttpClearProxy (http_t http) {
-	if (http->autoProxy) {
-		free(http->autoProxy);
-		http->autoProxy = NULL;
-	}
+	attempts = HttpRetryAttempts(http, request->type);
 
-	if (http->proxy) {
-		free(http->proxy);
-		http->proxy = NULL;
-	}
+	for (attempt = used + 1; ; ++attempt) {
+		unsigned int retryAfter = 0;
+		unsigned int delay = 0;
+		unsigned long long started;
+		http_metrics metrics;
 
-	if (http->proxyUsername) {
-		free(http->proxyUsername);
-		http->proxyUsername = NULL;
-	}
+		if (http->breakerOpenUntil != 0) {
+			if (HttpTickCount() < http->breakerOpenUntil) {
+				++http->stats.breakerRejects;
+				message = "Too many failed requests, waiting before trying again";
+				break;
+			}
+			/* half-open, this attempt decides */
+			http->breakerOpenUntil = 0;
+		}
+
+		HttpBufferClear(response);
+		request->responseData = NULL;
+		request->responseDataSize = 0;
+
+		memset(&metrics, 0, sizeof(metrics));
+		started = HttpMicroseconds();
+		status = http->backend->Request(http->http, request, response,
+			&retryAfter, &metrics);
+		metrics.phase[HTTP_PHASE_TOTAL] = HttpMicroseconds() - started;
 
-	if (http->proxyPassword) {
-		free(http->proxyPassword);
-		http->proxyPassword = NULL;
+		/* empty body is still a valid, NUL-terminated string */
+		if (status == HTTP_STATUS_OK && !HttpBufferReserve(response, 0)) {
+			message = "Out of memory";
+			status = HTTP_STATUS_FATAL;
+			break;
+		}
+
+		if (status == HTTP_STATUS_OK) {
+			HttpSucceeded(http, request, response, &metrics);
+			break;
+		}
+
+		message = http->backend->GetError(http->http);
+
+		if (!HttpShouldRetry(http, status, attempt, attempts, retryAfter,
+				&delay))
+			break;
+
+		HttpSleep(delay);
 	}
-}
 
-bool HttpSetAutoProxy (http_t http, const char* url) {
-	HttpClearProxy (http);
-	if (HttpSetProxy (http, url)) {
-		http->autoProxy = http->proxy;
-		http->proxy     = NULL;
-		return true;
+	if (status == HTTP_STATUS_OK)
+		*error = NULL;
+	else {
+		++http->stats.failures;
+		*error = message ? strdup(message) : NULL;
 	}
-	else
-		return false;
+
+	HttpMutexUnlock(&http->backendLock);
+
+	return status == HTTP_STATUS_OK;
 }
 
-static void HttpUrlDecodeInplace (wchar_t* url)
-{
-	wchar_t* input = url;
-	wchar_t* output = url;
-	size_t size = wcslen (url);
-	while (size > 0) {
-		if (input[0] == '%' && iswxdigit(input[1]) && iswxdigit(input[2])) {
-			wchar_t hex[3];
-			hex[0] = input[1];
-			hex[1] = input[2];
-			hex[2] = 0;
-			*output++ = (wchar_t)(wcstol (hex, NULL, 16));
-			input += 3;
-			size -= 3;
+/*	perform jobs of one batch, all at once if the backend can, one after
+ *	another otherwise. Read-only requests that failed transiently are
+ *	repeated the usual way with what is left of their retry budget, others
+ *	may have reached the server already and fail right away. Identical
+ *	read-only requests are sent only once.
+ */
+static void HttpPerformBatch (http_t http, http_job** jobs, size_t count) {
+	http_batch_item items[HTTP_BATCH_MAX];
+	/* index of job whose answer is used, the job itself unless coalesced */
+	size_t source[HTTP_BATCH_MAX];
+	size_t itemJob[HTTP_BATCH_MAX];
+	/* succeeded or failed for good */
+	bool done[HTTP_BATCH_MAX];
+	/* attempts spent by the batch */
+	unsigned int used[HTTP_BATCH_MAX];
+	unsigned int wait = 0;
+	size_t i, k, sent = 0;
+
+	memset(done, 0, sizeof(done));
+	memset(used, 0, sizeof(used));
+
+	HttpMutexLock(&http->backendLock);
+	/* an open breaker is handled by HttpPerform */
+	if (http->backend->RequestBatch && http->breakerOpenUntil == 0) {
+		unsigned long long started, elapsed;
+		const char* message = NULL;
+
+		memset(items, 0, sizeof(items));
+		for (i = 0; i < count; ++i) {
+			PianoRequest_t* request = jobs[i]->request;
+
+			source[i] = i;
+			HttpBufferClear(&jobs[i]->response);
+			request->responseData = NULL;
+			request->responseDataSize = 0;
+
+			if (HttpCacheServe(http, request, &jobs[i]->response)) {
+				jobs[i]->succeeded = done[i] = true;
+				continue;
+			}
+
+			for (k = 0; request->cacheKey && k < i; ++k) {
+				if (source[k] == k && !done[k] && jobs[k]->request->cacheKey &&
+						strcmp(jobs[k]->request->cacheKey,
+							request->cacheKey) == 0) {
+					source[i] = k;
+					++http->stats.coalesced;
+					break;
+				}
+			}
+			if (source[i] != i)
+				continue;
+
+			items[sent].request  = request;
+			items[sent].response = &jobs[i]->response;
+			itemJob[sent++] = i;
 		}
-		else {
-			*output++ = *input++;
-			--size;
+
+		started = HttpMicroseconds();
+		if (sent > 0) {
+			http->backend->RequestBatch(http->http, items, sent);
+			message = http->backend->GetError(http->http);
+		}
+		elapsed = HttpMicroseconds() - started;
+
+		for (k = 0; k < sent; ++k) {
+			http_job* job = jobs[itemJob[k]];
+			unsigned int attempts, delay = 0;
+
+			used[itemJob[k]] = 1;
+
+			if (items[k].status == HTTP_STATUS_OK &&
+					HttpBufferReserve(items[k].response, 0)) {
+				if (items[k].metrics.phase[HTTP_PHASE_TOTAL] == 0)
+					items[k].metrics.phase[HTTP_PHASE_TOTAL] = elapsed;
+				HttpSucceeded(http, items[k].request, items[k].response,
+					&items[k].metrics);
+				job->succeeded = done[itemJob[k]] = true;
+				continue;
+			}
+
+			/* one attempt only for anything that is not read-only */
+			attempts = items[k].request->cacheKey ?
+				HttpRetryAttempts(http, items[k].request->type) : 1;
+			if (items[k].status == HTTP_STATUS_OK) {
+				/* answer arrived, but there was no room for it */
+				message = "Out of memory";
+			}
+			else if (HttpShouldRetry(http, items[k].status, 1, attempts,
+					items[k].retryAfter, &delay)) {
+				if (delay > wait)
+					wait = delay;
+				continue;
+			}
+
+			++http->stats.failures;
+			job->error = message ? strdup(message) : NULL;
+			job->succeeded = false;
+			done[itemJob[k]] = true;
+		}
+
+		/* copies share the fate of their source, those of repeated
+		 * requests are answered from cache below */
+		for (i = 0; i < count; ++i) {
+			const http_job* from = jobs[source[i]];
+			PianoRequest_t* request = jobs[i]->request;
+
+			if (source[i] == i)
+				continue;
+
+			used[i] = used[source[i]];
+			if (!done[source[i]])
+				continue;
+
+			if (!from->succeeded) {
+				jobs[i]->error = from->error ? strdup(from->error) : NULL;
+				jobs[i]->succeeded = false;
+				done[i] = true;
+				continue;
+			}
+
+			if (!HttpBufferAppend(&jobs[i]->response, from->response.data,
+					from->response.size) ||
+					!HttpBufferReserve(&jobs[i]->response, 0))
+				continue;
+
+			request->responseData = jobs[i]->response.data;
+			request->responseDataSize = jobs[i]->response.size;
+			jobs[i]->succeeded = done[i] = true;
 		}
 	}
+	HttpMutexUnlock(&http->backendLock);
+
+	if (wait > 0)
+		HttpSleep(wait);
+
+	for (i = 0; i < count; ++i)
+		if (!done[i])
+			jobs[i]->succeeded = HttpPerform(http, jobs[i]->request,
+					&jobs[i]->response, &jobs[i]->error, used[i]);
+}
+
+static void HttpWorker (void* arg) {
+	http_t http = arg;
+
+	HttpMutexLock(&http->queueLock);
+	for (;;) {
+		http_job* jobs[HTTP_BATCH_MAX];
+		size_t count, i;
+
+		while (!http->workerQuit && !http->submitted.first)
+			HttpCondWait(&http->queueChanged, &http->queueLock);
 
-	if (output < input) {
-		*output = '\0';
+		if (http->workerQuit)
+			break;
+
+		/* take the whole batch, jobs outside of one go out one by one */
+		jobs[0] = HttpJobQueuePop(&http->submitted);
+		count = 1;
+		while (jobs[0]->batch != 0 && count < HTTP_BATCH_MAX &&
+				http->submitted.first &&
+				http->submitted.first->batch == jobs[0]->batch)
+			jobs[count++] = HttpJobQueuePop(&http->submitted);
+		http->busy = true;
+		HttpMutexUnlock(&http->queueLock);
+
+		if (count == 1)
+			jobs[0]->succeeded = HttpPerform(http, jobs[0]->request,
+					&jobs[0]->response, &jobs[0]->error, 0);
+		else
+			HttpPerformBatch(http, jobs, count);
+
+		HttpMutexLock(&http->queueLock);
+		http->busy = false;
+		/* callbacks still see submission order */
+		for (i = 0; i < count; ++i)
+			HttpJobQueuePush(&http->completed, jobs[i]);
+		HttpCondBroadcast(&http->queueChanged);
 	}
+	HttpMutexUnlock(&http->queueLock);
 }
 
-bool HttpSetProxy (http_t http, const char* url) {
-	URL_COMPONENTS urlComponents;
-	wchar_t* wideUrl = NULL;
-	wchar_t* wideUrl2 = NULL;
-	wchar_t* wideUsername = NULL;
-	wchar_t* widePassword = NULL;
-
-	ZeroMemory(&urlComponents, sizeof(urlComponents));
-	urlComponents.dwStructSize      = sizeof(urlComponents);
-	urlComponents.dwUserNameLength = -1;
-	urlComponents.dwPasswordLength = -1;
-
-	wideUrl = HttpToWideString(url, -1);
-	if (WinHttpCrackUrl(wideUrl, (DWORD)wcslen(wideUrl), 0, &urlComponents)) {
-		if (urlComponents.lpszUserName && urlComponents.dwUserNameLength > 0) {
-			wideUsername = wcsdup(urlComponents.lpszUserName);
-			wideUsername[urlComponents.dwUserNameLength] = 0;
-			HttpUrlDecodeInplace (wideUsername);
-		}
-		if (urlComponents.lpszPassword && urlComponents.dwPasswordLength > 0) {
-			widePassword = wcsdup(urlComponents.lpszPassword);
-			widePassword[urlComponents.dwPasswordLength] = 0;
-			HttpUrlDecodeInplace (widePassword);
+/*	create http handle using the first backend that initializes successfully
+ *	@param out handle
+ *	@param backend id or NULL to pick the first available one
+ *	@param backend configuration, stats are filled in here
+ *	@return true on success
+ */
+static bool HttpCreate (http_t* outHttp, const char* defaultBackend,
+		http_config* config) {
+	http_t http;
+	int i;
+
+	http = calloc(1, sizeof(struct _http_t));
+	if (!http)
+		return false;
+
+	config->stats = &http->stats;
+
+	/* start looking up the host now, so its addresses are known by the
+	 * time the first request goes out; endpoint may carry a port */
+	if (config->endpoint[0] != '\0') {
+		char host[256];
+		const char* colon = strrchr(config->endpoint, ':');
+		size_t length = strlen(config->endpoint);
+
+		if (colon && strchr(config->endpoint, ':') == colon)
+			length = (size_t)(colon - config->endpoint);
+		if (length < sizeof(host)) {
+			memcpy(host, config->endpoint, length);
+			host[length] = '\0';
+			http->resolver = HttpResolverCreate(host);
 		}
 	}
+	config->resolver = http->resolver;
 
-	ZeroMemory(&urlComponents, sizeof(urlComponents));
-	urlComponents.dwStructSize = sizeof(urlComponents);
-	urlComponents.dwHostNameLength  = -1;
-	urlComponents.dwUrlPathLength   = -1;
+	for (i = 0; http_backends[i] != NULL; ++i) {
+		http_iface* backend = http_backends[i];
 
-	if (!WinHttpCrackUrl(wideUrl, (DWORD)wcslen(wideUrl), 0, &urlComponents)) {
-		free(wideUsername);
-		free(widePassword);
-		return false;
+		if (defaultBackend && strcmp(backend->Id, defaultBackend) != 0)
+			continue;
+
+		http->http = backend->Create(config);
+		if (http->http) {
+			http->backend = backend;
+			break;
+		}
 	}
 
-	if (urlComponents.lpszHostName && urlComponents.dwHostNameLength > 0) {
-		wideUrl2 = wcsdup(urlComponents.lpszHostName);
-		wideUrl2[urlComponents.lpszUrlPath - urlComponents.lpszHostName] = 0;
+	if (!http->backend) {
+		HttpResolverDestroy(http->resolver);
+		free(http);
+		return false;
 	}
 
-	free(wideUrl);
+	HttpRetryPolicyDefault(&http->retry);
+	http->cacheTtl = HTTP_CACHE_TTL;
+	http->jitterState = (unsigned int)HttpTickCount() | 1;
+
+	HttpMutexInit(&http->backendLock);
+	HttpMutexInit(&http->queueLock);
+	HttpCondInit(&http->queueChanged);
+
+	*outHttp = http;
 
-	HttpClearProxy(http);
-	http->proxy         = wideUrl2;
-	http->proxyUsername = wideUsername;
-	http->proxyPassword = widePassword;
 	return true;
 }
 
-bool HttpRequest(http_t http, PianoRequest_t * const request) {
-	HINTERNET handle = NULL;
-	wchar_t* wideQuery = NULL;
-	bool requestSent = false;
-	bool complete = false;
-	int retryLimit = 3;
-	size_t responseDataSize;
-
-	wideQuery = HttpToWideString(request->urlPath, -1);
-	WINHTTP_SAFE_DONE(wideQuery != NULL);
-
-	handle = WinHttpOpenRequest(
-		http->connection,
-		L"POST",
-		wideQuery,
-		L"HTTP/1.1",
-		WINHTTP_NO_REFERER,
-		WINHTTP_DEFAULT_ACCEPT_TYPES,
-		request->secure ? WINHTTP_FLAG_SECURE : 0);
-	WINHTTP_SAFE_DONE(handle != NULL);
-
-	if (http->proxy || http->autoProxy) {
-		wchar_t* fullUrl;
-		DWORD fullUrlSize = 0;
-		WINHTTP_PROXY_INFO proxyInfo;
-		bool success;
-
-		if (http->autoProxy) {
-			WINHTTP_AUTOPROXY_OPTIONS proxyOptions = { 0 };
-
-			success = WinHttpQueryOption(request, WINHTTP_OPTION_URL, NULL, &fullUrlSize);
-			WINHTTP_SAFE(!success && GetLastError() == ERROR_INSUFFICIENT_BUFFER);
-			fullUrl = calloc(1, fullUrlSize + 1);
-			success = WinHttpQueryOption(request, WINHTTP_OPTION_URL, fullUrl, &fullUrlSize);
-			if (!success) {
-				free(fullUrl);
-				WINHTTP_SAFE(success);
-			}
+/*	create http handle for the rpc host
+ *	@param out handle
+ *	@param backend id or NULL to pick the first available one
+ *	@param rpc host
+ *	@param tls port
+ *	@param time-out in seconds
+ *	@return true on success
+ */
+bool HttpInit (http_t* outHttp, const char* defaultBackend,
+		const char* endpoint, const char* securePort, unsigned int timeOut) {
+	http_config config;
+
+	memset(&config, 0, sizeof(config));
+	config.endpoint   = endpoint;
+	config.securePort = securePort;
+	config.timeOut    = timeOut;
+
+	return HttpCreate(outHttp, defaultBackend, &config);
+}
 
-			proxyOptions.lpszAutoConfigUrl = http->autoProxy;
-			proxyOptions.dwFlags = WINHTTP_AUTOPROXY_CONFIG_URL;
+/*	create http handle that serves responses from a record file instead of
+ *	the network, see HttpSetRecordFile
+ *	@param out handle
+ *	@param record file
+ *	@param latency of each request in milliseconds, negative to use the
+ *		recorded one
+ *	@return true on success
+ */
+bool HttpInitReplay (http_t* outHttp, const char* path, int latency) {
+	http_config config;
+
+	memset(&config, 0, sizeof(config));
+	config.endpoint      = "";
+	config.securePort    = "";
+	config.replayFile    = path;
+	config.replayLatency = latency;
+
+	return HttpCreate(outHttp, http_replay.Id, &config);
+}
 
-			if (!(success = WinHttpGetProxyForUrl(http->session, fullUrl, &proxyOptions, &proxyInfo))) {
-				proxyOptions.fAutoLogonIfChallenged = true;
-				success = WinHttpGetProxyForUrl(http->session, fullUrl, &proxyOptions, &proxyInfo);
-			}
+/*	destroy http handle, requests still queued are dropped without calling
+ *	their callbacks, use HttpWait first to avoid that
+ */
+void HttpDestroy (http_t http) {
+	http_job* job;
 
-			if (!success) {
-				free(fullUrl);
-				WINHTTP_SAFE(success);
-			}
-		}
-		else {
-			proxyInfo.dwAccessType    = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
-			proxyInfo.lpszProxy       = http->proxy;
-			proxyInfo.lpszProxyBypass = NULL;
+	if (http) {
+		if (http->workerRunning) {
+			HttpMutexLock(&http->queueLock);
+			http->workerQuit = true;
+			HttpCondBroadcast(&http->queueChanged);
+			HttpMutexUnlock(&http->queueLock);
+			HttpThreadJoin(http->worker);
 		}
 
-		WINHTTP_SAFE(WinHttpSetOption(handle,
-			WINHTTP_OPTION_PROXY,
-			&proxyInfo, sizeof(proxyInfo)));
-
-		if (http->proxyUsername && http->proxyPassword) {
-			WINHTTP_SAFE(WinHttpSetCredentials(handle,
-				WINHTTP_AUTH_TARGET_PROXY,
-				WINHTTP_AUTH_SCHEME_BASIC,
-				http->proxyUsername,
-				http->proxyPassword,
-				NULL));
-		}
+		while ((job = HttpJobQueuePop(&http->submitted)))
+			HttpJobFree(job);
+		while ((job = HttpJobQueuePop(&http->completed)))
+			HttpJobFree(job);
+		while ((job = HttpJobQueuePop(&http->staged)))
+			HttpJobFree(job);
+
+		if (http->http)
+			http->backend->Destroy(http->http);
+		HttpResolverDestroy(http->resolver);
+		HttpBufferFree(&http->response);
+		HttpCacheClear(http);
+		if (http->record)
+			fclose(http->record);
+		free(http->error);
+		HttpCondDestroy(&http->queueChanged);
+		HttpMutexDestroy(&http->queueLock);
+		HttpMutexDestroy(&http->backendLock);
+		free(http);
 	}
+}
 
-	while (retryLimit > 0) {
-		DWORD errorCode, statusCode, statusCodeSize;
-		bool succeeded = false;
-		bool retry = false;
-
-		if (!requestSent) {
-			size_t postDataSize = strlen(request->postData);
-			succeeded = WinHttpSendRequest(handle,
-				WINHTTP_NO_ADDITIONAL_HEADERS,
-				0,
-				request->postData,
-				(DWORD)postDataSize,
-				(DWORD)postDataSize,
-				0);
-
-			if (succeeded)
-				requestSent = true;
-		}
+bool HttpSetAutoProxy (http_t http, const char* url) {
+	bool result;
+	HttpMutexLock(&http->backendLock);
+	free(http->error);
+	http->error = NULL;
+	result = http->backend->SetAutoProxy(http->http, url);
+	HttpMutexUnlock(&http->backendLock);
+	return result;
+}
 
-		if (requestSent)
-			succeeded = WinHttpReceiveResponse(handle, NULL);
+bool HttpSetProxy (http_t http, const char* url) {
+	bool result;
+	HttpMutexLock(&http->backendLock);
+	free(http->error);
+	http->error = NULL;
+	result = http->backend->SetProxy(http->http, url);
+	HttpMutexUnlock(&http->backendLock);
+	return result;
+}
 
-		errorCode = GetLastError();
+/*	keep answers of read-only requests for a while; identical requests
+ *	waiting for the connection or in the same batch are answered by the
+ *	first one's response then
+ *	@param http handle
+ *	@param milliseconds, 0 disables caching and drops what is cached
+ */
+void HttpSetCacheTtl (http_t http, unsigned int ttl) {
+	HttpMutexLock(&http->backendLock);
+	http->cacheTtl = ttl;
+	if (ttl == 0)
+		HttpCacheClear(http);
+	HttpMutexUnlock(&http->backendLock);
+}
 
-		statusCode = 0;
-		statusCodeSize = sizeof(statusCode);
-		if (!WinHttpQueryHeaders(handle,
-				WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-				WINHTTP_HEADER_NAME_BY_INDEX,
-				&statusCode, &statusCodeSize, WINHTTP_NO_HEADER_INDEX)) {
-			statusCode = 0;
-		}
+void HttpSetCompression (http_t http, bool enabled) {
+	HttpMutexLock(&http->backendLock);
+	http->backend->SetCompression(http->http, enabled);
+	HttpMutexUnlock(&http->backendLock);
+}
 
-		if (succeeded && statusCode == 407) {
-			wchar_t statusText[256] = { 0 };
-			DWORD statusTextSize = sizeof(statusText) - 1;
-			WinHttpQueryHeaders(handle,
-				WINHTTP_QUERY_STATUS_TEXT,
-				WINHTTP_HEADER_NAME_BY_INDEX,
-				statusText, &statusTextSize, WINHTTP_NO_HEADER_INDEX);
-			HttpSetLastErrorW (http, statusText);
-			requestSent = false;
-			retry       = true;
-		}
-		else if (succeeded && (statusCode >= 500 && statusCode <= 599))
-		{
-			wchar_t statusText[256] = { 0 };
-			DWORD statusTextSize = sizeof(statusText) - 1;
-			WinHttpQueryHeaders(handle,
-				WINHTTP_QUERY_STATUS_TEXT,
-				WINHTTP_HEADER_NAME_BY_INDEX,
-				statusText, &statusTextSize, WINHTTP_NO_HEADER_INDEX);
-			HttpSetLastErrorW (http, statusText);
-			requestSent = false;
-			retry       = true;
-		}
-		else {
-			if (errorCode == ERROR_SUCCESS)
-				break;
+/*	append every successful request to file, which can be served again by
+ *	HttpInitReplay
+ *	@param http handle
+ *	@param file, truncated; NULL stops recording
+ *	@return true on success
+ */
+bool HttpSetRecordFile (http_t http, const char* path) {
+	FILE* record = NULL;
+	bool result = true;
+
+	/* binary, response sizes are byte counts */
+	if (path && (!(record = fopen(path, "wb")) ||
+			fputs(HTTP_RECORD_MAGIC, record) == EOF)) {
+		if (record)
+			fclose(record);
+		record = NULL;
+		result = false;
+	}
 
-			switch (errorCode) {
-				case ERROR_WINHTTP_RESEND_REQUEST:
-					requestSent = false;
-					/* pass trough */
+	HttpMutexLock(&http->backendLock);
+	if (http->record)
+		fclose(http->record);
+	http->record = record;
+	HttpMutexUnlock(&http->backendLock);
 
-				case ERROR_WINHTTP_NAME_NOT_RESOLVED:
-				case ERROR_WINHTTP_CANNOT_CONNECT:
-				case ERROR_WINHTTP_TIMEOUT:
-					retry = true;
-					break;
+	return result;
+}
 
-				default:
-					HttpSetLastErrorFromWinHttp (http);
-					goto done;
-			}
+/*	perform request, on success request->responseData points into buffer
+ *	owned by http handle and stays valid until the next request
+ */
+bool HttpRequest (http_t http, PianoRequest_t * const request) {
+	free(http->error);
+	http->error = NULL;
+	return HttpPerform(http, request, &http->response, &http->error, 0);
+}
+
+/*	queue request to be performed on worker thread, callback is invoked by
+ *	HttpPoll once it is done
+ *	@param http handle
+ *	@param request, must stay valid until callback is called
+ *	@param completion callback
+ *	@param user data passed to callback
+ *	@return true if request was queued
+ */
+bool HttpRequestAsync (http_t http, PianoRequest_t * const request,
+		HttpCallback_t callback, void* userData) {
+	http_job* job = calloc(1, sizeof(http_job));
+	if (!job)
+		return false;
+
+	job->request  = request;
+	job->callback = callback;
+	job->userData = userData;
+	job->response.request = request;
+
+	HttpMutexLock(&http->queueLock);
+	if (!http->workerRunning) {
+		http->workerRunning = HttpThreadCreate(&http->worker, HttpWorker, http);
+		if (!http->workerRunning) {
+			HttpMutexUnlock(&http->queueLock);
+			free(job);
+			return false;
 		}
+	}
+	if (http->batchDepth > 0) {
+		job->batch = http->batchSerial;
+		HttpJobQueuePush(&http->staged, job);
+	}
+	else {
+		HttpJobQueuePush(&http->submitted, job);
+		HttpCondBroadcast(&http->queueChanged);
+	}
+	++http->pending;
+	HttpMutexUnlock(&http->queueLock);
+
+	return true;
+}
 
-		if (retry)
-			--retryLimit;
+/*	group async requests queued until HttpBatchEnd; they must not depend on
+ *	each other, since the backend may send them at the same time over one
+ *	connection (http/2 streams) or several; callbacks are still called in
+ *	the order the requests were queued. Pairs may nest, the outermost one
+ *	counts.
+ *	@param http handle
+ */
+void HttpBatchBegin (http_t http) {
+	HttpMutexLock(&http->queueLock);
+	if (http->batchDepth++ == 0) {
+		/* 0 means no batch */
+		if (++http->batchSerial == 0)
+			++http->batchSerial;
 	}
+	HttpMutexUnlock(&http->queueLock);
+}
 
-	responseDataSize = 0;
-	while (retryLimit > 0)
-	{
-		DWORD bytesLeft;
-		char* writePtr;
+/*	hand staged requests to the worker, queueLock held
+ */
+static void HttpBatchSubmit (http_t http) {
+	if (!http->staged.first)
+		return;
 
-		DWORD bytesAvailable = 0;
-		if (!WinHttpQueryDataAvailable(handle, &bytesAvailable)) {
-			WINHTTP_SAFE(GetLastError() == ERROR_WINHTTP_TIMEOUT);
-			--retryLimit;
-			continue;
+	if (http->submitted.last)
+		http->submitted.last->next = http->staged.first;
+	else
+		http->submitted.first = http->staged.first;
+	http->submitted.last = http->staged.last;
+	memset(&http->staged, 0, sizeof(http->staged));
+	HttpCondBroadcast(&http->queueChanged);
+}
+
+/*	submit requests queued since HttpBatchBegin
+ *	@param http handle
+ */
+void HttpBatchEnd (http_t http) {
+	HttpMutexLock(&http->queueLock);
+	if (http->batchDepth > 0 && --http->batchDepth == 0)
+		HttpBatchSubmit(http);
+	HttpMutexUnlock(&http->queueLock);
+}
+
+/*	invoke callbacks of finished async requests
+ *	@param http handle
+ *	@return number of callbacks invoked
+ */
+size_t HttpPoll (http_t http) {
+	http_job_queue completed;
+	http_job* job;
+	size_t count = 0;
+
+	HttpMutexLock(&http->queueLock);
+	completed = http->completed;
+	memset(&http->completed, 0, sizeof(http->completed));
+	HttpMutexUnlock(&http->queueLock);
+
+	/* callbacks run unlocked, they are free to queue more requests */
+	while ((job = HttpJobQueuePop(&completed))) {
+		job->callback(http, job->request, job->succeeded, job->error,
+				job->userData);
+		HttpJobFree(job);
+
+		HttpMutexLock(&http->queueLock);
+		--http->pending;
+		HttpMutexUnlock(&http->queueLock);
+
+		++count;
+	}
+
+	return count;
+}
+
+/*	number of async requests whose callbacks have not been called yet
+ */
+size_t HttpPending (http_t http) {
+	size_t pending;
+	HttpMutexLock(&http->queueLock);
+	pending = http->pending;
+	HttpMutexUnlock(&http->queueLock);
+	return pending;
+}
+
+/*	block until all async requests, including those queued by callbacks,
+ *	are finished and their callbacks called. Requests of a batch that is
+ *	still open are submitted right away, those queued after this call form
+ *	a batch of their own.
+ */
+void HttpWait (http_t http) {
+	for (;;) {
+		HttpMutexLock(&http->queueLock);
+		if (http->staged.first) {
+			HttpBatchSubmit(http);
+			if (++http->batchSerial == 0)
+				++http->batchSerial;
 		}
+		while (http->submitted.first || http->busy)
+			HttpCondWait(&http->queueChanged, &http->queueLock);
+		HttpMutexUnlock(&http->queueLock);
 
-		if (0 == bytesAvailable)
+		if (HttpPoll(http) == 0)
 			break;
+	}
+}
 
-		responseDataSize += bytesAvailable;
-		request->responseData = realloc(request->responseData, responseDataSize + 1);
+const char* HttpGetError (http_t http) {
+	const char* error;
+	if (http->error)
+		return http->error;
+	HttpMutexLock(&http->backendLock);
+	error = http->backend->GetError(http->http);
+	HttpMutexUnlock(&http->backendLock);
+	return error;
+}
 
-		writePtr = request->responseData + responseDataSize - bytesAvailable;
-		writePtr[bytesAvailable] = 0;
+const char* HttpGetBackendName (http_t http) {
+	return http->backend->Name;
+}
 
-		bytesLeft = bytesAvailable;
-		while (bytesLeft > 0)
-		{
-			DWORD bytesRead = 0;
-			if (!WinHttpReadData(handle, writePtr, bytesLeft, &bytesRead))
-			{
-				WINHTTP_SAFE(GetLastError() == ERROR_WINHTTP_TIMEOUT);
-				if (--retryLimit == 0)
-					break;
+void HttpGetStats (http_t http, HttpStats_t* stats) {
+	HttpMutexLock(&http->backendLock);
+	*stats = http->stats;
+	HttpMutexUnlock(&http->backendLock);
 
-				continue;
-			}
+	if (http->resolver)
+		HttpResolverGetStats(http->resolver, stats);
+}
 
-			bytesLeft -= bytesRead;
-			writePtr  += bytesRead;
-		}
+void HttpGetRequestStats (http_t http, PianoRequestType_t type,
+		HttpRequestStats_t* stats) {
+	if ((unsigned int)type >= HTTP_REQUEST_TYPES) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	HttpMutexLock(&http->backendLock);
+	*stats = http->requestStats[type];
+	HttpMutexUnlock(&http->backendLock);
+}
 
-		if (bytesLeft > 0)
-			HttpSetLastError (http, "Incomplete response data");
+static const char* HttpRequestTypeName (PianoRequestType_t type) {
+	switch (type) {
+		case PIANO_REQUEST_LOGIN:				return "login";
+		case PIANO_REQUEST_GET_STATIONS:		return "get stations";
+		case PIANO_REQUEST_GET_PLAYLIST:		return "get playlist";
+		case PIANO_REQUEST_RATE_SONG:			return "rate song";
+		case PIANO_REQUEST_ADD_FEEDBACK:		return "add feedback";
+		case PIANO_REQUEST_RENAME_STATION:		return "rename station";
+		case PIANO_REQUEST_DELETE_STATION:		return "delete station";
+		case PIANO_REQUEST_SEARCH:				return "search";
+		case PIANO_REQUEST_CREATE_STATION:		return "create station";
+		case PIANO_REQUEST_ADD_SEED:			return "add seed";
+		case PIANO_REQUEST_ADD_TIRED_SONG:		return "add tired song";
+		case PIANO_REQUEST_SET_QUICKMIX:		return "set quickmix";
+		case PIANO_REQUEST_GET_GENRE_STATIONS:	return "get genre stations";
+		case PIANO_REQUEST_TRANSFORM_STATION:	return "transform station";
+		case PIANO_REQUEST_EXPLAIN:				return "explain";
+		case PIANO_REQUEST_BOOKMARK_SONG:		return "bookmark song";
+		case PIANO_REQUEST_BOOKMARK_ARTIST:		return "bookmark artist";
+		case PIANO_REQUEST_GET_STATION_INFO:	return "get station info";
+		case PIANO_REQUEST_DELETE_FEEDBACK:		return "delete feedback";
+		case PIANO_REQUEST_DELETE_SEED:			return "delete seed";
+		case PIANO_REQUEST_GET_SETTINGS:		return "get settings";
+		case PIANO_REQUEST_CHANGE_SETTINGS:		return "change settings";
+		case PIANO_REQUEST_GET_STATION_MODES:	return "get station modes";
+		case PIANO_REQUEST_SET_STATION_MODE:	return "set station mode";
+		default:								return "unknown";
 	}
+}
+
+/*	append formatted text to buffer
+ */
+static void HttpBufferPrintf (http_buffer* buffer, const char* format, ...) {
+	char line[256];
+	va_list args;
+	int size;
+
+	va_start(args, format);
+	size = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	if (size > 0)
+		HttpBufferAppend(buffer, line,
+			(size_t)size < sizeof(line) ? (size_t)size : sizeof(line) - 1);
+}
+
+/*	counters and per request type histograms in human readable form
+ *	@param http handle
+ *	@return text to be freed by caller or NULL
+ */
+char* HttpFormatStats (http_t http) {
+	static const char* const phaseNames[HTTP_PHASE_COUNT] = {
+		"dns", "connect", "tls", "send", "wait", "body", "total"
+	};
+	http_buffer text;
+	HttpStats_t stats;
+	int type, phase, bucket;
+
+	memset(&text, 0, sizeof(text));
+
+	HttpGetStats(http, &stats);
+
+	HttpMutexLock(&http->backendLock);
+
+	HttpBufferPrintf(&text, "http backend: %s\n", http->backend->Name);
+	if (stats.tlsResumedKnown)
+		HttpBufferPrintf(&text, "connections: %lu reused, %lu opened, "
+			"%lu tls resumed\n", stats.poolHits, stats.poolMisses,
+			stats.tlsResumed);
+	else
+		HttpBufferPrintf(&text, "connections: %lu reused, %lu opened, "
+			"tls resumption unknown\n", stats.poolHits, stats.poolMisses);
+	HttpBufferPrintf(&text, "failures: %lu retries, %lu failed, "
+		"%lu breaker trips, %lu rejected\n", stats.retries, stats.failures,
+		stats.breakerTrips, stats.breakerRejects);
+	HttpBufferPrintf(&text, "bytes: %llu received, %llu decoded\n",
+		stats.bytesReceived, stats.bytesDecoded);
+	HttpBufferPrintf(&text, "cache: %lu hits, %lu misses, %lu coalesced\n",
+		stats.cacheHits, stats.cacheMisses, stats.coalesced);
+	if (stats.resolves > 0)
+		HttpBufferPrintf(&text, "dns: %lu lookups, %lu failed, "
+			"mean %.2f ms, max %.2f ms\n", stats.resolves,
+			stats.resolveFailures,
+			stats.resolveTime / 1000.0 / stats.resolves,
+			stats.resolveTimeMax / 1000.0);
+
+	for (type = 0; type < HTTP_REQUEST_TYPES; ++type) {
+		const HttpRequestStats_t* requestStats = &http->requestStats[type];
+
+		if (requestStats->requests == 0)
+			continue;
+
+		HttpBufferPrintf(&text, "%s: %lu requests, %llu bytes sent, "
+			"%llu received, %llu decoded\n",
+			HttpRequestTypeName((PianoRequestType_t)type),
+			requestStats->requests, requestStats->bytesSent,
+			requestStats->bytesReceived, requestStats->bytesDecoded);
+
+		for (phase = 0; phase < HTTP_PHASE_COUNT; ++phase) {
+			const HttpHistogram_t* histogram = &requestStats->phase[phase];
+			const unsigned long measured =
+				requestStats->requests - histogram->unknown;
+
+			if (histogram->unknown > 0)
+				HttpBufferPrintf(&text, "  %-8s unknown for %lu requests\n",
+					phaseNames[phase], histogram->unknown);
+			if (histogram->max == 0)
+				continue;
 
-	if (retryLimit == 0)
-	{
-		HttpSetLastError (http, "Maximum retries count exceeded");
-		goto done;
+			HttpBufferPrintf(&text, "  %-8s mean %8.2f ms, max %8.2f ms |",
+				phaseNames[phase], histogram->sum / 1000.0 / measured,
+				histogram->max / 1000.0);
+			for (bucket = 0; bucket < HTTP_HISTOGRAM_BUCKETS; ++bucket) {
+				if (histogram->count[bucket] == 0)
+					continue;
+				if (bucket == HTTP_HISTOGRAM_BUCKETS - 1)
+					HttpBufferPrintf(&text, " >=%lums:%lu", 1ul << (bucket - 1),
+						histogram->count[bucket]);
+				else
+					HttpBufferPrintf(&text, " <%lums:%lu", 1ul << bucket,
+						histogram->count[bucket]);
+			}
+			HttpBufferPrintf(&text, "\n");
+		}
 	}
 
-	complete = true;
+	HttpMutexUnlock(&http->backendLock);
+
+	return text.data;
+}
+
+/*	write HttpFormatStats to file
+ *	@return true on success
+ */
+bool HttpDumpStats (http_t http, FILE* file) {
+	char* text = HttpFormatStats(http);
+	bool result = text && fputs(text, file) != EOF;
+	free(text);
+	return result;
+}
+
+/*	make room for at least size bytes plus terminating NUL, capacity is
+ *	doubled so appending chunk by chunk stays linear
+ *	@param buffer
+ *	@param bytes needed
+ *	@return true on success
+ */
+bool HttpBufferReserve (http_buffer* buffer, size_t size) {
+	size_t capacity = buffer->capacity;
+	char* data;
+
+	if (buffer->data && size < capacity)
+		return true;
+
+	if (capacity < 4096)
+		capacity = 4096;
+	while (capacity <= size)
+		capacity *= 2;
+
+	data = realloc(buffer->data, capacity);
+	if (!data)
+		return false;
+
+	if (!buffer->data)
+		data[0] = 0;
+
+	buffer->data     = data;
+	buffer->capacity = capacity;
+	return true;
+}
+
+bool HttpBufferAppend (http_buffer* buffer, const char* data, size_t size) {
+	if (!HttpBufferReserve(buffer, buffer->size + size))
+		return false;
+
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	buffer->data[buffer->size] = 0;
+
+	/* parsing overlaps with receiving the rest */
+	if (buffer->request)
+		PianoResponseFeed(buffer->request, data, size);
+	return true;
+}
+
+/*	take size bytes written right behind data into reserved space, for
+ *	backends reading straight into the buffer
+ */
+void HttpBufferCommit (http_buffer* buffer, size_t size) {
+	const char* data = buffer->data + buffer->size;
+
+	buffer->size += size;
+	buffer->data[buffer->size] = 0;
+
+	if (buffer->request)
+		PianoResponseFeed(buffer->request, data, size);
+}
 
-	HttpSetLastError (http, NULL);
+void HttpBufferClear (http_buffer* buffer) {
+	buffer->size = 0;
+	if (buffer->data)
+		buffer->data[0] = 0;
+	if (buffer->request)
+		PianoResponseReset(buffer->request);
+}
+
+void HttpBufferFree (http_buffer* buffer) {
+	free(buffer->data);
+	memset(buffer, 0, sizeof(*buffer));
+}
 
-done:
-	free(wideQuery);
-	return complete;
+/*	fill in default retry policy
+ */
+void HttpRetryPolicyDefault (HttpRetryPolicy_t* policy) {
+	memset(policy, 0, sizeof(*policy));
+	policy->defaultAttempts  = 3;
+	policy->baseDelay        = 250;
+	policy->maxDelay         = 8000;
+	policy->breakerThreshold = 6;
+	policy->breakerCooldown  = 30000;
+
+	/* these are not idempotent, a timed out attempt may have gone through
+	 * already and repeating it would leave duplicates behind */
+	policy->attempts[PIANO_REQUEST_CREATE_STATION] = 1;
+	policy->attempts[PIANO_REQUEST_ADD_SEED]       = 1;
+	policy->attempts[PIANO_REQUEST_ADD_FEEDBACK]   = 1;
+	policy->attempts[PIANO_REQUEST_RATE_SONG]      = 1;
+	policy->attempts[PIANO_REQUEST_BOOKMARK_SONG]  = 1;
+	policy->attempts[PIANO_REQUEST_BOOKMARK_ARTIST] = 1;
+	policy->attempts[PIANO_REQUEST_TRANSFORM_STATION] = 1;
 }
 
-const char* HttpGetError(http_t http) {
-	return http->error;
+void HttpSetRetryPolicy (http_t http, const HttpRetryPolicy_t* policy) {
+	HttpMutexLock(&http->backendLock);
+	http->retry = *policy;
+	http->consecutiveFailures = 0;
+	http->breakerOpenUntil = 0;
+	HttpMutexUnlock(&http->backendLock);
 }
@@ -26,18 +26,132 @@ THE SOFTWARE.
 #include "config.h"
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "piano.h"
 #include "settings.h"
 
 typedef struct _http_t *http_t;
 
-bool HttpInit (http_t*, const char*, const char*, unsigned int);
+typedef struct {
+	/* requests served over an already open connection */
+	unsigned long poolHits;
+	/* requests that had to open a new connection */
+	unsigned long poolMisses;
+	/* tls handshakes that resumed a previous session, only counted if the
+	 * backend can tell, see tlsResumedKnown */
+	unsigned long tlsResumed;
+	bool tlsResumedKnown;
+	/* attempts repeated after a transient failure */
+	unsigned long retries;
+	/* requests that failed for good */
+	unsigned long failures;
+	/* times the circuit breaker opened */
+	unsigned long breakerTrips;
+	/* requests refused without trying while breaker was open */
+	unsigned long breakerRejects;
+	/* response body bytes as they came over the wire */
+	unsigned long long bytesReceived;
+	/* response body bytes after content decoding */
+	unsigned long long bytesDecoded;
+	/* background lookups of the rpc host and how many failed */
+	unsigned long resolves;
+	unsigned long resolveFailures;
+	/* microseconds spent in those lookups, total and longest */
+	unsigned long long resolveTime;
+	unsigned long long resolveTimeMax;
+	/* read-only requests answered from cache and sent to the server */
+	unsigned long cacheHits;
+	unsigned long cacheMisses;
+	/* duplicates in a batch answered by the first copy's response */
+	unsigned long coalesced;
+} HttpStats_t;
+
+/* largest PianoRequestType_t + 1 */
+#define HTTP_REQUEST_TYPES 32
+
+/* parts of a request that are timed separately */
+typedef enum {
+	HTTP_PHASE_DNS,
+	HTTP_PHASE_CONNECT,
+	HTTP_PHASE_TLS,
+	HTTP_PHASE_SEND,
+	/* time to first byte once the request is out */
+	HTTP_PHASE_WAIT,
+	HTTP_PHASE_BODY,
+	/* whole attempt as seen by the dispatcher */
+	HTTP_PHASE_TOTAL,
+	HTTP_PHASE_COUNT
+} HttpPhase_t;
+
+/* bucket 0 counts durations below 1 ms, bucket n below 2^n ms, the last
+ * one everything longer */
+#define HTTP_HISTOGRAM_BUCKETS 16
+
+typedef struct {
+	unsigned long count[HTTP_HISTOGRAM_BUCKETS];
+	/* requests the backend could not time this phase for, not part of
+	 * count, sum and max */
+	unsigned long unknown;
+	/* microseconds */
+	unsigned long long sum;
+	unsigned long long max;
+} HttpHistogram_t;
+
+/* successful requests of one type */
+typedef struct {
+	unsigned long requests;
+	/* request and response bodies */
+	unsigned long long bytesSent;
+	unsigned long long bytesReceived;
+	unsigned long long bytesDecoded;
+	HttpHistogram_t phase[HTTP_PHASE_COUNT];
+} HttpRequestStats_t;
+
+/* how transient failures (connect errors, time-outs, 5xx) are retried */
+typedef struct {
+	/* attempts per request including the first one, indexed by request
+	 * type; 0 = use defaultAttempts */
+	unsigned int attempts[HTTP_REQUEST_TYPES];
+	unsigned int defaultAttempts;
+	/* exponential backoff with full jitter, milliseconds */
+	unsigned int baseDelay;
+	unsigned int maxDelay;
+	/* consecutive failed attempts that open the breaker, 0 = never */
+	unsigned int breakerThreshold;
+	/* milliseconds before a single probe is let through again */
+	unsigned int breakerCooldown;
+} HttpRetryPolicy_t;
+
+/* called from HttpPoll on the thread that polls, request->responseData is
+ * valid only for the duration of the call */
+typedef void (*HttpCallback_t) (http_t http, PianoRequest_t *request,
+		bool succeeded, const char *error, void *userData);
+
+bool HttpInit (http_t*, const char*, const char*, const char*, unsigned int);
+bool HttpInitReplay (http_t*, const char*, int);
 void HttpDestroy (http_t);
 
 bool HttpSetAutoProxy (http_t, const char*);
 bool HttpSetProxy(http_t, const char*);
+void HttpSetCompression (http_t, bool);
+void HttpSetCacheTtl (http_t, unsigned int);
+bool HttpSetRecordFile (http_t, const char*);
 
 bool HttpRequest (http_t, PianoRequest_t * const);
+bool HttpRequestAsync (http_t, PianoRequest_t * const, HttpCallback_t, void *);
+void HttpBatchBegin (http_t);
+void HttpBatchEnd (http_t);
+size_t HttpPoll (http_t);
+size_t HttpPending (http_t);
+void HttpWait (http_t);
 const char* HttpGetError (http_t);
+const char* HttpGetBackendName (http_t);
+void HttpGetStats (http_t, HttpStats_t*);
+void HttpGetRequestStats (http_t, PianoRequestType_t, HttpRequestStats_t*);
+char* HttpFormatStats (http_t);
+bool HttpDumpStats (http_t, FILE*);
+
+void HttpRetryPolicyDefault (HttpRetryPolicy_t*);
+void HttpSetRetryPolicy (http_t, const HttpRetryPolicy_t*);
 
@@ -0,0 +1,143 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.h"
+#include <stdbool.h>
+#include "http.h"
+
+/* response body storage, grows geometrically and is kept by the dispatcher
+ * across requests */
+typedef struct _http_buffer
+{
+	char*			data;
+	size_t			size;
+	size_t			capacity;
+	/* response body of this request, parsed as it is appended (see
+	 * PianoResponseFeed); NULL for other buffers */
+	PianoRequest_t*	request;
+} http_buffer;
+
+bool HttpBufferReserve (http_buffer* buffer, size_t size);
+bool HttpBufferAppend (http_buffer* buffer, const char* data, size_t size);
+void HttpBufferCommit (http_buffer* buffer, size_t size);
+void HttpBufferClear (http_buffer* buffer);
+void HttpBufferFree (http_buffer* buffer);
+
+/* outcome of single attempt, dispatcher decides whether to try again */
+typedef enum _http_status
+{
+	HTTP_STATUS_OK,
+	/* nothing or possibly incomplete data received, may be repeated */
+	HTTP_STATUS_TRANSIENT,
+	/* repeating would not help */
+	HTTP_STATUS_FATAL
+} http_status;
+
+/* phase duration the backend cannot measure */
+#define HTTP_PHASE_UNKNOWN (~0ull)
+
+/* measurements of single attempt, filled by backend */
+typedef struct _http_metrics
+{
+	/* microseconds, 0 for phases that did not happen (reused connection),
+	 * HTTP_PHASE_UNKNOWN if they cannot be told apart; HTTP_PHASE_TOTAL is
+	 * up to the dispatcher */
+	unsigned long long	phase[HTTP_PHASE_COUNT];
+	/* request body and response body as it came over the wire */
+	unsigned long long	bytesSent;
+	unsigned long long	bytesReceived;
+} http_metrics;
+
+/* most requests handed to a backend at once, see RequestBatch */
+#define HTTP_BATCH_MAX 8
+
+/* one request of a batch, everything but request and response is filled in
+ * by the backend */
+typedef struct _http_batch_item
+{
+	PianoRequest_t*	request;
+	http_buffer*	response;
+	http_status		status;
+	unsigned int	retryAfter;
+	/* HTTP_PHASE_TOTAL is set by the backend here, transfers overlap */
+	http_metrics	metrics;
+} http_batch_item;
+
+typedef struct _http_config
+{
+	const char*		endpoint;
+	const char*		securePort;
+	unsigned int	timeOut;
+	/* owned by dispatcher, backends update counters */
+	HttpStats_t*	stats;
+	/* replay backend only: file made by HttpSetRecordFile and latency in
+	 * milliseconds, negative to use the recorded one */
+	const char*		replayFile;
+	int				replayLatency;
+	/* addresses of the endpoint host, NULL if not resolved in background */
+	struct _http_resolver*	resolver;
+} http_config;
+
+/* record file starts with this line, followed by one entry per successful
+ * request:
+ *   <type> <latency ms> <urlPath size> <postData size> <response size>\n
+ *   <urlPath><postData><response>\n
+ * postData is left empty, it carries the login and auth tokens; tokens in
+ * urlPath and response are overwritten with 'x' */
+#define HTTP_RECORD_MAGIC "pianobar-http-record 1\n"
+
+typedef struct _http_iface
+{
+	const char*		Id;
+	const char*		Name;
+	http_t			(*Create)		(const http_config* config);
+	void			(*Destroy)		(http_t http);
+	bool			(*SetAutoProxy)	(http_t http, const char* url);
+	bool			(*SetProxy)		(http_t http, const char* url);
+	/* ask for gzip/deflate encoded responses, backend decodes them before
+	 * they reach the response buffer; on by default */
+	void			(*SetCompression)	(http_t http, bool enabled);
+	/* single attempt, response body goes to buffer, which is cleared by
+	 * the caller; retryAfter is set to server's Retry-After in seconds,
+	 * metrics are zeroed by the caller */
+	http_status		(*Request)		(http_t http, PianoRequest_t * const request,
+										http_buffer* response,
+										unsigned int* retryAfter,
+										http_metrics* metrics);
+	/* optional, single attempt of up to HTTP_BATCH_MAX independent requests
+	 * at the same time, e.g. as streams of one http/2 connection; same
+	 * rules as Request otherwise */
+	void			(*RequestBatch)	(http_t http, http_batch_item* items,
+										size_t count);
+	const char*		(*GetError)		(http_t http);
+} http_iface;
+
+#ifdef _WIN32
+extern http_iface http_winhttp;
+#endif
+#ifdef HAVE_LIBCURL
+extern http_iface http_curl;
+#endif
+extern http_iface http_replay;
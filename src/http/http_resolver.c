@@ -0,0 +1,350 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* background resolver for the rpc host, see http_resolver.h */
+
+#include "config.h"
+
+/* winsock2 has to come before Windows.h */
+#ifdef _WIN32
+# include <winsock2.h>
+# include <ws2tcpip.h>
+# include <windns.h>
+# ifdef _MSC_VER
+#  pragma comment(lib, "ws2_32.lib")
+#  pragma comment(lib, "dnsapi.lib")
+# endif
+#else
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <netdb.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include <arpa/nameser.h>
+# include <resolv.h>
+#endif
+
+#include "http_resolver.h"
+#include "http_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* seconds, used if the record's ttl cannot be found out */
+#define HTTP_RESOLVER_DEFAULT_TTL	300
+/* seconds, lower bound so a ttl of 0 does not keep the thread spinning */
+#define HTTP_RESOLVER_MIN_TTL		10
+/* milliseconds before a failed lookup is repeated */
+#define HTTP_RESOLVER_RETRY			(30 * 1000)
+/* addresses handed out per family */
+#define HTTP_RESOLVER_MAX_PER_FAMILY	4
+
+struct _http_resolver {
+	char*			host;
+	http_mutex		lock;
+	http_cond		wake;
+	http_thread		thread;
+	bool			running;
+	bool			quit;
+	/* guarded by lock */
+	char			addresses[HTTP_RESOLVER_ADDRESSES];
+	unsigned int	generation;
+	unsigned long long	refreshAt;
+	unsigned long	resolves;
+	unsigned long	failures;
+	unsigned long long	resolveTime;
+	unsigned long long	resolveTimeMax;
+};
+
+/*	time to live of the host's A record
+ *	@return seconds, 0 if unknown
+ */
+static unsigned int HttpResolverTtl (const char* host) {
+	unsigned int ttl = 0;
+#ifdef _WIN32
+	PDNS_RECORD records = NULL, record;
+
+	/* answers from the dns client cache carry the remaining ttl */
+	if (DnsQuery_UTF8(host, DNS_TYPE_A, DNS_QUERY_STANDARD, NULL, &records,
+			NULL) != 0)
+		return 0;
+
+	for (record = records; record != NULL; record = record->pNext)
+		if (record->wType == DNS_TYPE_A && (ttl == 0 || record->dwTtl < ttl))
+			ttl = record->dwTtl;
+
+	DnsRecordListFree(records, DnsFreeRecordList);
+#else
+	unsigned char answer[4096];
+	ns_msg message;
+	ns_rr record;
+	int size, i;
+
+	size = res_query(host, ns_c_in, ns_t_a, answer, sizeof(answer));
+	if (size < 0 || ns_initparse(answer, size, &message) < 0)
+		return 0;
+
+	for (i = 0; i < ns_msg_count(message, ns_s_an); ++i)
+		if (ns_parserr(&message, ns_s_an, i, &record) == 0 &&
+				ns_rr_type(record) == ns_t_a &&
+				(ttl == 0 || ns_rr_ttl(record) < ttl))
+			ttl = ns_rr_ttl(record);
+#endif
+	return ttl;
+}
+
+/*	first entry of family at or after given one
+ */
+static const struct addrinfo* HttpResolverNext (const struct addrinfo* entry,
+		int family) {
+	while (entry != NULL && entry->ai_family != family)
+		entry = entry->ai_next;
+	return entry;
+}
+
+/*	resolve host, no locks held
+ *	@param host
+ *	@param comma separated addresses, v6 in brackets; families alternate,
+ *		starting with the preferred one, so a client racing connections
+ *		(happy eyeballs) tries both early
+ *	@param size of addresses
+ *	@param seconds the result is valid
+ *	@return true on success
+ */
+static bool HttpResolverLookup (const char* host, char* addresses,
+		size_t size, unsigned int* ttl) {
+	struct addrinfo hints, *result = NULL;
+	const struct addrinfo* next[2];
+	int families[2], count[2] = { 0, 0 };
+	size_t length = 0;
+	int turn;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host, NULL, &hints, &result) != 0 || result == NULL)
+		return false;
+
+	families[0] = result->ai_family;
+	families[1] = families[0] == AF_INET6 ? AF_INET : AF_INET6;
+	next[0] = result;
+	next[1] = HttpResolverNext(result, families[1]);
+
+	addresses[0] = '\0';
+	for (turn = 0; next[0] != NULL || next[1] != NULL; turn ^= 1) {
+		const struct addrinfo* entry = next[turn];
+		char address[INET6_ADDRSTRLEN];
+		const void* raw;
+		int written;
+
+		if (entry == NULL)
+			continue;
+		next[turn] = HttpResolverNext(entry->ai_next, families[turn]);
+
+		if (count[turn] >= HTTP_RESOLVER_MAX_PER_FAMILY)
+			continue;
+
+		if (entry->ai_family == AF_INET6)
+			raw = &((const struct sockaddr_in6*)entry->ai_addr)->sin6_addr;
+		else
+			raw = &((const struct sockaddr_in*)entry->ai_addr)->sin_addr;
+		if (!inet_ntop(entry->ai_family, (void*)raw, address, sizeof(address)))
+			continue;
+
+		written = snprintf(addresses + length, size - length,
+			entry->ai_family == AF_INET6 ? "%s[%s]" : "%s%s",
+			length > 0 ? "," : "", address);
+		if (written < 0 || (size_t)written >= size - length) {
+			/* keep what fits */
+			addresses[length] = '\0';
+			break;
+		}
+		length += (size_t)written;
+		++count[turn];
+	}
+
+	freeaddrinfo(result);
+
+	if (length == 0)
+		return false;
+
+	*ttl = HttpResolverTtl(host);
+	if (*ttl == 0)
+		*ttl = HTTP_RESOLVER_DEFAULT_TTL;
+	else if (*ttl < HTTP_RESOLVER_MIN_TTL)
+		*ttl = HTTP_RESOLVER_MIN_TTL;
+
+	return true;
+}
+
+/*	looks the host up right away, then again after three quarters of the
+ *	ttl passed, so a valid answer is always at hand; on failure the last
+ *	good answer is served until a lookup succeeds again
+ */
+static void HttpResolverThread (void* arg) {
+	http_resolver* resolver = arg;
+
+	HttpMutexLock(&resolver->lock);
+	while (!resolver->quit) {
+		char addresses[HTTP_RESOLVER_ADDRESSES];
+		unsigned long long now = HttpTickCount();
+		unsigned long long started, elapsed;
+		unsigned int ttl = 0;
+		bool success;
+
+		if (now < resolver->refreshAt) {
+			HttpCondWaitTimeout(&resolver->wake, &resolver->lock,
+				(unsigned int)(resolver->refreshAt - now));
+			continue;
+		}
+
+		HttpMutexUnlock(&resolver->lock);
+		started = HttpMicroseconds();
+		success = HttpResolverLookup(resolver->host, addresses,
+			sizeof(addresses), &ttl);
+		elapsed = HttpMicroseconds() - started;
+		HttpMutexLock(&resolver->lock);
+
+		++resolver->resolves;
+		resolver->resolveTime += elapsed;
+		if (elapsed > resolver->resolveTimeMax)
+			resolver->resolveTimeMax = elapsed;
+
+		if (success) {
+			if (strcmp(addresses, resolver->addresses) != 0) {
+				strcpy(resolver->addresses, addresses);
+				/* 0 means no addresses */
+				if (++resolver->generation == 0)
+					++resolver->generation;
+			}
+			resolver->refreshAt = HttpTickCount() + ttl * 750ull;
+		}
+		else {
+			++resolver->failures;
+			resolver->refreshAt = HttpTickCount() + HTTP_RESOLVER_RETRY;
+		}
+	}
+	HttpMutexUnlock(&resolver->lock);
+}
+
+/*	start resolving host in background
+ *	@param host name or address literal
+ *	@return resolver or NULL
+ */
+http_resolver* HttpResolverCreate (const char* host) {
+	http_resolver* resolver;
+
+	resolver = calloc(1, sizeof(*resolver));
+	if (!resolver)
+		return NULL;
+
+	resolver->host = strdup(host);
+	if (!resolver->host) {
+		free(resolver);
+		return NULL;
+	}
+
+#ifdef _WIN32
+	{
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+			free(resolver->host);
+			free(resolver);
+			return NULL;
+		}
+	}
+#endif
+
+	HttpMutexInit(&resolver->lock);
+	HttpCondInit(&resolver->wake);
+
+	resolver->running = HttpThreadCreate(&resolver->thread,
+		HttpResolverThread, resolver);
+
+	return resolver;
+}
+
+void HttpResolverDestroy (http_resolver* resolver) {
+	if (!resolver)
+		return;
+
+	if (resolver->running) {
+		/* a lookup in progress cannot be cancelled, this waits for it */
+		HttpMutexLock(&resolver->lock);
+		resolver->quit = true;
+		HttpCondBroadcast(&resolver->wake);
+		HttpMutexUnlock(&resolver->lock);
+		HttpThreadJoin(resolver->thread);
+	}
+
+	HttpCondDestroy(&resolver->wake);
+	HttpMutexDestroy(&resolver->lock);
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	free(resolver->host);
+	free(resolver);
+}
+
+/*	current addresses, see HttpResolverLookup for the format
+ *	@param resolver
+ *	@param destination
+ *	@param size of destination
+ *	@return generation, changes whenever the addresses do; 0 if there are
+ *		none yet
+ */
+unsigned int HttpResolverGet (http_resolver* resolver, char* addresses,
+		size_t size) {
+	unsigned int generation;
+
+	HttpMutexLock(&resolver->lock);
+	generation = resolver->generation;
+	if (generation != 0 && strlen(resolver->addresses) < size)
+		strcpy(addresses, resolver->addresses);
+	else
+		generation = 0;
+	HttpMutexUnlock(&resolver->lock);
+
+	return generation;
+}
+
+/*	look up again right away, e.g. when connecting to known addresses failed
+ */
+void HttpResolverInvalidate (http_resolver* resolver) {
+	HttpMutexLock(&resolver->lock);
+	resolver->refreshAt = 0;
+	HttpCondBroadcast(&resolver->wake);
+	HttpMutexUnlock(&resolver->lock);
+}
+
+/*	copy lookup counters into stats
+ */
+void HttpResolverGetStats (http_resolver* resolver, HttpStats_t* stats) {
+	HttpMutexLock(&resolver->lock);
+	stats->resolves        = resolver->resolves;
+	stats->resolveFailures = resolver->failures;
+	stats->resolveTime     = resolver->resolveTime;
+	stats->resolveTimeMax  = resolver->resolveTimeMax;
+	HttpMutexUnlock(&resolver->lock);
+}
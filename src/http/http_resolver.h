@@ -0,0 +1,44 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* addresses of the rpc host, looked up by a background thread so neither
+ * login nor reconnects wait for a slow resolver */
+
+#pragma once
+
+#include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "http.h"
+
+/* enough for a handful of v4 and v6 addresses */
+#define HTTP_RESOLVER_ADDRESSES 512
+
+typedef struct _http_resolver http_resolver;
+
+http_resolver* HttpResolverCreate (const char* host);
+void HttpResolverDestroy (http_resolver* resolver);
+unsigned int HttpResolverGet (http_resolver* resolver, char* addresses,
+		size_t size);
+void HttpResolverInvalidate (http_resolver* resolver);
+void HttpResolverGetStats (http_resolver* resolver, HttpStats_t* stats);
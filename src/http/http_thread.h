@@ -0,0 +1,195 @@
+﻿/*
+Copyright (c) 2015
+	Michał Cichoń <thedmd@interia.pl>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+/* minimal thread and timing primitives used by the http layer, Win32 and
+ * pthreads */
+
+#pragma once
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <process.h>
+
+typedef CRITICAL_SECTION	http_mutex;
+typedef CONDITION_VARIABLE	http_cond;
+typedef HANDLE				http_thread;
+
+typedef void (*http_thread_proc) (void* arg);
+
+typedef struct {
+	http_thread_proc	proc;
+	void*				arg;
+} http_thread_start;
+
+static inline unsigned __stdcall HttpThreadTrampoline (void* arg) {
+	http_thread_start start = *(http_thread_start*)arg;
+	free(arg);
+	start.proc(start.arg);
+	return 0;
+}
+
+static inline bool HttpThreadCreate (http_thread* thread,
+		http_thread_proc proc, void* arg) {
+	http_thread_start* start = malloc(sizeof(http_thread_start));
+	if (!start)
+		return false;
+	start->proc = proc;
+	start->arg  = arg;
+	*thread = (HANDLE)_beginthreadex(NULL, 0, HttpThreadTrampoline, start, 0, NULL);
+	if (*thread == NULL) {
+		free(start);
+		return false;
+	}
+	return true;
+}
+
+static inline void HttpThreadJoin (http_thread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+static inline void HttpMutexInit (http_mutex* mutex) { InitializeCriticalSection(mutex); }
+static inline void HttpMutexDestroy (http_mutex* mutex) { DeleteCriticalSection(mutex); }
+static inline void HttpMutexLock (http_mutex* mutex) { EnterCriticalSection(mutex); }
+static inline void HttpMutexUnlock (http_mutex* mutex) { LeaveCriticalSection(mutex); }
+
+static inline void HttpCondInit (http_cond* cond) { InitializeConditionVariable(cond); }
+static inline void HttpCondDestroy (http_cond* cond) { (void)cond; }
+static inline void HttpCondWait (http_cond* cond, http_mutex* mutex) {
+	SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+static inline void HttpCondWaitTimeout (http_cond* cond, http_mutex* mutex,
+		unsigned int milliseconds) {
+	SleepConditionVariableCS(cond, mutex, milliseconds);
+}
+static inline void HttpCondBroadcast (http_cond* cond) { WakeAllConditionVariable(cond); }
+
+static inline void HttpSleep (unsigned int milliseconds) { Sleep(milliseconds); }
+
+/* monotonic clock in milliseconds */
+static inline unsigned long long HttpTickCount (void) { return GetTickCount64(); }
+
+/* monotonic clock in microseconds, for measurements */
+static inline unsigned long long HttpMicroseconds (void) {
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (unsigned long long)(now.QuadPart / frequency.QuadPart * 1000000 +
+		now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+#else
+
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+
+typedef pthread_mutex_t		http_mutex;
+typedef pthread_cond_t		http_cond;
+typedef pthread_t			http_thread;
+
+typedef void (*http_thread_proc) (void* arg);
+
+typedef struct {
+	http_thread_proc	proc;
+	void*				arg;
+} http_thread_start;
+
+static inline void* HttpThreadTrampoline (void* arg) {
+	http_thread_start start = *(http_thread_start*)arg;
+	free(arg);
+	start.proc(start.arg);
+	return NULL;
+}
+
+static inline bool HttpThreadCreate (http_thread* thread,
+		http_thread_proc proc, void* arg) {
+	http_thread_start* start = malloc(sizeof(http_thread_start));
+	if (!start)
+		return false;
+	start->proc = proc;
+	start->arg  = arg;
+	if (pthread_create(thread, NULL, HttpThreadTrampoline, start) != 0) {
+		free(start);
+		return false;
+	}
+	return true;
+}
+
+static inline void HttpThreadJoin (http_thread thread) {
+	pthread_join(thread, NULL);
+}
+
+static inline void HttpMutexInit (http_mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void HttpMutexDestroy (http_mutex* mutex) { pthread_mutex_destroy(mutex); }
+static inline void HttpMutexLock (http_mutex* mutex) { pthread_mutex_lock(mutex); }
+static inline void HttpMutexUnlock (http_mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+static inline void HttpCondInit (http_cond* cond) { pthread_cond_init(cond, NULL); }
+static inline void HttpCondDestroy (http_cond* cond) { pthread_cond_destroy(cond); }
+static inline void HttpCondWait (http_cond* cond, http_mutex* mutex) {
+	pthread_cond_wait(cond, mutex);
+}
+static inline void HttpCondWaitTimeout (http_cond* cond, http_mutex* mutex,
+		unsigned int milliseconds) {
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec  += milliseconds / 1000;
+	deadline.tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec  += 1;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	pthread_cond_timedwait(cond, mutex, &deadline);
+}
+static inline void HttpCondBroadcast (http_cond* cond) { pthread_cond_broadcast(cond); }
+
+static inline void HttpSleep (unsigned int milliseconds) {
+	struct timespec delay;
+	delay.tv_sec  = milliseconds / 1000;
+	delay.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+	while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+		;
+}
+
+/* monotonic clock in milliseconds */
+static inline unsigned long long HttpTickCount (void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* monotonic clock in microseconds, for measurements */
+static inline unsigned long long HttpMicroseconds (void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "../config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "piano_private.h"
+
+/* most responses fit into one block */
+#define PIANO_ARENA_BLOCK_SIZE 4096
+
+typedef struct PianoArenaBlock {
+	struct PianoArenaBlock *next;
+	size_t used, size;
+	/* max_align_t is C11 */
+	union {
+		long double ld;
+		void *p;
+		long long ll;
+	} data[];
+} PianoArenaBlock_t;
+
+struct PianoArena {
+	PianoArenaBlock_t *blocks;
+	/* nodes allocated here plus the creator's reference */
+	size_t refs;
+};
+
+/*	create arena, caller holds one reference
+ *	@return arena or NULL
+ */
+PianoArena_t *PianoArenaNew (void) {
+	PianoArena_t * const arena = calloc (1, sizeof (*arena));
+
+	if (arena != NULL) {
+		arena->refs = 1;
+	}
+	return arena;
+}
+
+/*	zeroed memory that lives as long as the arena, suitably aligned for any
+ *	type
+ *	@param arena
+ *	@param size in bytes
+ *	@return memory or NULL
+ */
+void *PianoArenaAlloc (PianoArena_t * const arena, size_t size) {
+	const size_t align = sizeof (((PianoArenaBlock_t *) NULL)->data[0]);
+	PianoArenaBlock_t *block;
+
+	assert (arena != NULL);
+
+	size = (size + align - 1) / align * align;
+	block = arena->blocks;
+
+	if (block == NULL || block->size - block->used < size) {
+		const size_t blockSize = size > PIANO_ARENA_BLOCK_SIZE ? size :
+				PIANO_ARENA_BLOCK_SIZE;
+
+		if ((block = malloc (sizeof (*block) + blockSize)) == NULL) {
+			return NULL;
+		}
+		block->used = 0;
+		block->size = blockSize;
+		if (size > PIANO_ARENA_BLOCK_SIZE && arena->blocks != NULL) {
+			/* oversized allocation gets a block of its own, keep filling
+			 * the current one */
+			block->next = arena->blocks->next;
+			arena->blocks->next = block;
+		} else {
+			block->next = arena->blocks;
+			arena->blocks = block;
+		}
+	}
+
+	char * const p = (char *) block->data + block->used;
+	block->used += size;
+	memset (p, 0, size);
+	return p;
+}
+
+/*	copy string into arena
+ *	@param arena
+ *	@param string or NULL
+ *	@return copy, NULL if string is NULL or out of memory
+ */
+char *PianoArenaStrdup (PianoArena_t * const arena, const char * const s) {
+	char *copy;
+	size_t size;
+
+	if (s == NULL) {
+		return NULL;
+	}
+
+	size = strlen (s) + 1;
+	if ((copy = PianoArenaAlloc (arena, size)) != NULL) {
+		memcpy (copy, s, size);
+	}
+	return copy;
+}
+
+/*	allocate list node that keeps the arena alive until it is destroyed
+ *	@param arena
+ *	@param size of node
+ *	@return node or NULL
+ */
+void *PianoArenaNode (PianoArena_t * const arena, const size_t size) {
+	void * const node = PianoArenaAlloc (arena, size);
+
+	if (node != NULL) {
+		++arena->refs;
+	}
+	return node;
+}
+
+/*	add reference for memory from PianoArenaAlloc that becomes a list node
+ *	@param arena
+ */
+void PianoArenaRetain (PianoArena_t * const arena) {
+	assert (arena != NULL);
+	assert (arena->refs > 0);
+
+	++arena->refs;
+}
+
+/*	drop reference, frees all blocks once the last one is gone
+ *	@param arena or NULL
+ */
+void PianoArenaRelease (PianoArena_t * const arena) {
+	PianoArenaBlock_t *block;
+
+	if (arena == NULL) {
+		return;
+	}
+
+	assert (arena->refs > 0);
+	if (--arena->refs > 0) {
+		return;
+	}
+
+	block = arena->blocks;
+	while (block != NULL) {
+		PianoArenaBlock_t * const next = block->next;
+		free (block);
+		block = next;
+	}
+	free (arena);
+}
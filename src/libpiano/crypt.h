@@ -32,4 +32,9 @@ void PianoCryptDestroy (PianoCipher_t);
 char *PianoDecryptString (PianoCipher_t, const char * const,
 		size_t * const);
 char *PianoEncryptString (PianoCipher_t, const char *);
+size_t PianoEncryptHexSize (const size_t);
+void PianoEncryptHex (PianoCipher_t, const char * const, const size_t,
+		char * const);
+bool PianoDecryptHex (PianoCipher_t, const char * const, const size_t,
+		unsigned char * const);
 
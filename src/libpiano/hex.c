@@ -0,0 +1,215 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "../config.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "hex.h"
+
+/* SSE2 is part of every x86-64 target; PIANO_HEX_SCALAR leaves the kernels
+ * out, see contrib/hex_scalar.c */
+#if !defined(PIANO_HEX_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || \
+		(defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PIANO_HEX_SSE2
+#include <emmintrin.h>
+#endif
+
+/* two lowercase digits per byte */
+static const char hexEncodeTable[512] =
+		"000102030405060708090a0b0c0d0e0f"
+		"101112131415161718191a1b1c1d1e1f"
+		"202122232425262728292a2b2c2d2e2f"
+		"303132333435363738393a3b3c3d3e3f"
+		"404142434445464748494a4b4c4d4e4f"
+		"505152535455565758595a5b5c5d5e5f"
+		"606162636465666768696a6b6c6d6e6f"
+		"707172737475767778797a7b7c7d7e7f"
+		"808182838485868788898a8b8c8d8e8f"
+		"909192939495969798999a9b9c9d9e9f"
+		"a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+		"b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+		"c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+		"d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+		"e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+		"f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/* nibble value of a digit, -1 if it is not one */
+static const int8_t hexDecodeTable[256] = {
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+		-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+#ifdef PIANO_HEX_SSE2
+/*	encode 16 bytes per iteration
+ *	@return number of bytes encoded
+ */
+static size_t PianoHexEncodeSse2 (char * const out,
+		const unsigned char * const in, const size_t size) {
+	const __m128i nibble = _mm_set1_epi8 (0x0f);
+	const __m128i nine = _mm_set1_epi8 (9);
+	const __m128i zero = _mm_set1_epi8 ('0');
+	/* distance from '9'+1 to 'a' */
+	const __m128i letter = _mm_set1_epi8 ('a' - '0' - 10);
+	size_t i;
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		const __m128i v = _mm_loadu_si128 ((const __m128i *) &in[i]);
+		__m128i hi = _mm_and_si128 (_mm_srli_epi16 (v, 4), nibble);
+		__m128i lo = _mm_and_si128 (v, nibble);
+
+		hi = _mm_add_epi8 (_mm_add_epi8 (hi, zero),
+				_mm_and_si128 (_mm_cmpgt_epi8 (hi, nine), letter));
+		lo = _mm_add_epi8 (_mm_add_epi8 (lo, zero),
+				_mm_and_si128 (_mm_cmpgt_epi8 (lo, nine), letter));
+
+		_mm_storeu_si128 ((__m128i *) &out[i*2], _mm_unpacklo_epi8 (hi, lo));
+		_mm_storeu_si128 ((__m128i *) &out[i*2+16],
+				_mm_unpackhi_epi8 (hi, lo));
+	}
+
+	return i;
+}
+
+/*	map 16 digits to their nibble values
+ *	@param digits
+ *	@param set to all ones in lanes holding a valid digit
+ */
+static __m128i PianoHexNibblesSse2 (const __m128i c, __m128i * const valid) {
+	const __m128i digit = _mm_sub_epi8 (c, _mm_set1_epi8 ('0'));
+	/* lowercases letters, digits have bit 5 set already */
+	const __m128i alpha = _mm_sub_epi8 (_mm_or_si128 (c, _mm_set1_epi8 (0x20)),
+			_mm_set1_epi8 ('a'));
+	/* unsigned x <= max */
+	const __m128i isDigit = _mm_cmpeq_epi8 (
+			_mm_min_epu8 (digit, _mm_set1_epi8 (9)), digit);
+	const __m128i isAlpha = _mm_cmpeq_epi8 (
+			_mm_min_epu8 (alpha, _mm_set1_epi8 (5)), alpha);
+
+	*valid = _mm_or_si128 (isDigit, isAlpha);
+	return _mm_or_si128 (_mm_and_si128 (isDigit, digit),
+			_mm_and_si128 (isAlpha, _mm_add_epi8 (alpha, _mm_set1_epi8 (10))));
+}
+
+/*	join pairs of nibbles, high nibble first, into the low byte of each 16
+ *	bit lane
+ */
+static __m128i PianoHexJoinSse2 (const __m128i n) {
+	return _mm_or_si128 (
+			_mm_slli_epi16 (_mm_and_si128 (n, _mm_set1_epi16 (0x00ff)), 4),
+			_mm_srli_epi16 (n, 8));
+}
+
+/*	decode 32 digits per iteration
+ *	@return number of bytes decoded, stops early at invalid digits
+ */
+static size_t PianoHexDecodeSse2 (unsigned char * const out,
+		const char * const in, const size_t size) {
+	size_t i;
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		__m128i validA, validB;
+		const __m128i a = PianoHexNibblesSse2 (
+				_mm_loadu_si128 ((const __m128i *) &in[i*2]), &validA);
+		const __m128i b = PianoHexNibblesSse2 (
+				_mm_loadu_si128 ((const __m128i *) &in[i*2+16]), &validB);
+
+		if (_mm_movemask_epi8 (_mm_and_si128 (validA, validB)) != 0xffff) {
+			/* let the scalar loop find the culprit */
+			break;
+		}
+
+		_mm_storeu_si128 ((__m128i *) &out[i],
+				_mm_packus_epi16 (PianoHexJoinSse2 (a), PianoHexJoinSse2 (b)));
+	}
+
+	return i;
+}
+#endif
+
+/*	hex-encode buffer, lowercase, not NUL-terminated
+ *	@param output, 2*size bytes
+ *	@param input
+ *	@param input size
+ */
+void PianoHexEncode (char * const out, const unsigned char * const in,
+		const size_t size) {
+	size_t i = 0;
+
+	assert (out != NULL);
+	assert (in != NULL || size == 0);
+
+#ifdef PIANO_HEX_SSE2
+	i = PianoHexEncodeSse2 (out, in, size);
+#endif
+
+	for (; i < size; i++) {
+		const char * const digits = &hexEncodeTable[in[i]*2];
+		out[i*2] = digits[0];
+		out[i*2+1] = digits[1];
+	}
+}
+
+/*	decode hex string, either case
+ *	@param output, size bytes
+ *	@param input, 2*size digits
+ *	@param output size
+ *	@return false if the input contains something else than digits
+ */
+bool PianoHexDecode (unsigned char * const out, const char * const in,
+		const size_t size) {
+	size_t i = 0;
+
+	assert (out != NULL);
+	assert (in != NULL || size == 0);
+
+#ifdef PIANO_HEX_SSE2
+	i = PianoHexDecodeSse2 (out, in, size);
+#endif
+
+	for (; i < size; i++) {
+		const int hi = hexDecodeTable[(unsigned char) in[i*2]];
+		const int lo = hexDecodeTable[(unsigned char) in[i*2+1]];
+		if (hi < 0 || lo < 0) {
+			return false;
+		}
+		out[i] = (unsigned char) (hi << 4 | lo);
+	}
+
+	return true;
+}
@@ -0,0 +1,211 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "../config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "piano_private.h"
+
+/* smallest table, must be a power of two */
+#define PIANO_INDEX_MIN_SIZE 16
+
+/*	FNV-1a of string, shared with the string table
+ */
+size_t PianoHashString (const char *s) {
+	uint32_t hash = 2166136261u;
+
+	while (*s != '\0') {
+		hash ^= (unsigned char) *s++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*	put station into first free slot, keeps the existing one on duplicate
+ *	ids, just like a list walk would find it first
+ */
+static void PianoIndexInsert (PianoStationIndex_t * const index,
+		PianoStation_t * const station) {
+	const size_t mask = index->size - 1;
+	size_t i = PianoHashString (station->id) & mask;
+
+	while (index->slots[i] != NULL) {
+		if (strcmp (index->slots[i]->id, station->id) == 0) {
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	index->slots[i] = station;
+	++index->used;
+}
+
+/*	rebuild index from station list, drops it if out of memory, lookups walk
+ *	the list until the next successful rebuild
+ *	@param piano handle
+ */
+static void PianoIndexRebuild (PianoHandle_t * const ph) {
+	PianoStationIndex_t * const index = &ph->stationIndex;
+	size_t size = PIANO_INDEX_MIN_SIZE, count = 0;
+
+	PianoStation_t *curStation = ph->stations;
+	PianoListForeachP (curStation) {
+		++count;
+	}
+
+	/* keep load factor at one half or below after rebuild */
+	while (size < count * 2) {
+		size *= 2;
+	}
+
+	free (index->slots);
+	index->used = 0;
+	if ((index->slots = calloc (size, sizeof (*index->slots))) == NULL) {
+		index->size = 0;
+		return;
+	}
+	index->size = size;
+
+	curStation = ph->stations;
+	PianoListForeachP (curStation) {
+		if (curStation->id != NULL) {
+			PianoIndexInsert (index, curStation);
+		}
+	}
+}
+
+/*	add station, which must be part of ph->stations already
+ *	@param piano handle
+ *	@param station
+ */
+void PianoIndexAdd (PianoHandle_t * const ph, PianoStation_t * const station) {
+	PianoStationIndex_t * const index = &ph->stationIndex;
+
+	assert (station != NULL);
+
+	if (station->id == NULL) {
+		return;
+	}
+
+	/* grow at three quarters load */
+	if (index->slots == NULL || (index->used + 1) * 4 > index->size * 3) {
+		PianoIndexRebuild (ph);
+	} else {
+		PianoIndexInsert (index, station);
+	}
+}
+
+/*	remove station before it is unlinked from ph->stations
+ *	@param piano handle
+ *	@param station
+ */
+void PianoIndexRemove (PianoHandle_t * const ph,
+		PianoStation_t * const station) {
+	PianoStationIndex_t * const index = &ph->stationIndex;
+
+	assert (station != NULL);
+
+	if (index->slots == NULL || station->id == NULL) {
+		return;
+	}
+
+	const size_t mask = index->size - 1;
+	size_t i = PianoHashString (station->id) & mask;
+
+	while (index->slots[i] != station) {
+		if (index->slots[i] == NULL) {
+			/* shadowed by a station with the same id */
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+
+	/* backward shift deletion, no tombstones */
+	size_t j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		if (index->slots[j] == NULL) {
+			break;
+		}
+		const size_t k = PianoHashString (index->slots[j]->id) & mask;
+		/* move entry unless its home slot lies cyclically in (i, j] */
+		if ((i <= j) ? (i >= k || k > j) : (i >= k && k > j)) {
+			index->slots[i] = index->slots[j];
+			i = j;
+		}
+	}
+	index->slots[i] = NULL;
+	--index->used;
+
+	/* a duplicate may have been hidden by the removed station */
+	PianoStation_t *curStation = ph->stations;
+	PianoListForeachP (curStation) {
+		if (curStation != station && curStation->id != NULL &&
+				strcmp (curStation->id, station->id) == 0) {
+			PianoIndexInsert (index, curStation);
+			break;
+		}
+	}
+}
+
+/*	free index
+ *	@param piano handle
+ */
+void PianoIndexDestroy (PianoHandle_t * const ph) {
+	free (ph->stationIndex.slots);
+	memset (&ph->stationIndex, 0, sizeof (ph->stationIndex));
+}
+
+/*	get station by id in constant time
+ *	@public yes
+ *	@param piano handle
+ *	@param station id, may be NULL
+ *	@return station or NULL
+ */
+PianoStation_t *PianoGetStationById (const PianoHandle_t * const ph,
+		const char * const id) {
+	const PianoStationIndex_t * const index = &ph->stationIndex;
+
+	if (id == NULL || ph->stations == NULL) {
+		return NULL;
+	}
+
+	if (index->slots == NULL) {
+		return PianoFindStationById (ph->stations, id);
+	}
+
+	const size_t mask = index->size - 1;
+	size_t i = PianoHashString (id) & mask;
+
+	while (index->slots[i] != NULL) {
+		/* ids of songs and stations are interned, equal ones share storage */
+		if (index->slots[i]->id == id || strcmp (index->slots[i]->id, id) == 0) {
+			return index->slots[i];
+		}
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
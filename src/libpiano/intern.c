@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "../config.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "piano_private.h"
+
+/* smallest table, must be a power of two */
+#define PIANO_INTERN_MIN_SIZE 64
+
+typedef struct PianoInterned {
+	/* NULL once the handle is gone */
+	struct PianoInternTable *table;
+	size_t refs, hash;
+	char s[];
+} PianoInterned_t;
+
+/* open addressing hash table of strings, the strings themselves are
+ * refcounted and freed when the last user releases them */
+struct PianoInternTable {
+	PianoInterned_t **slots;
+	size_t size, used;
+};
+
+static PianoInterned_t *PianoInternEntry (const char * const s) {
+	return (PianoInterned_t *) (s - offsetof (PianoInterned_t, s));
+}
+
+/*	move entries to table of given size
+ *	@return false if out of memory, the table is unchanged then
+ */
+static bool PianoInternResize (struct PianoInternTable * const t,
+		const size_t size) {
+	PianoInterned_t ** const slots = calloc (size, sizeof (*slots));
+
+	if (slots == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < t->size; i++) {
+		PianoInterned_t * const e = t->slots[i];
+		if (e != NULL) {
+			size_t k = e->hash & (size - 1);
+			while (slots[k] != NULL) {
+				k = (k + 1) & (size - 1);
+			}
+			slots[k] = e;
+		}
+	}
+
+	free (t->slots);
+	t->slots = slots;
+	t->size = size;
+	return true;
+}
+
+/*	get shared copy of string, release it with PianoInternRelease; the table
+ *	is not locked, use it from the thread that owns the handle only
+ *	@param piano handle
+ *	@param string or NULL
+ *	@return shared string, NULL if string is NULL or out of memory
+ */
+char *PianoIntern (PianoHandle_t * const ph, const char * const s) {
+	struct PianoInternTable *t = ph->interned;
+
+	if (s == NULL) {
+		return NULL;
+	}
+
+	if (t == NULL) {
+		if ((t = calloc (1, sizeof (*t))) == NULL) {
+			return NULL;
+		}
+		ph->interned = t;
+	}
+
+	/* grow at three quarters load */
+	if ((t->used + 1) * 4 > t->size * 3 && !PianoInternResize (t,
+			t->size > 0 ? t->size * 2 : PIANO_INTERN_MIN_SIZE)) {
+		return NULL;
+	}
+
+	const size_t hash = PianoHashString (s);
+	const size_t mask = t->size - 1;
+	size_t i = hash & mask;
+
+	while (t->slots[i] != NULL) {
+		PianoInterned_t * const e = t->slots[i];
+		if (e->hash == hash && strcmp (e->s, s) == 0) {
+			++e->refs;
+			return e->s;
+		}
+		i = (i + 1) & mask;
+	}
+
+	const size_t size = strlen (s) + 1;
+	PianoInterned_t * const e = malloc (sizeof (*e) + size);
+	if (e == NULL) {
+		return NULL;
+	}
+	e->table = t;
+	e->refs = 1;
+	e->hash = hash;
+	memcpy (e->s, s, size);
+
+	t->slots[i] = e;
+	++t->used;
+
+	return e->s;
+}
+
+/*	drop reference to shared string
+ *	@param string returned by PianoIntern or NULL
+ */
+void PianoInternRelease (char * const s) {
+	if (s == NULL) {
+		return;
+	}
+
+	PianoInterned_t * const e = PianoInternEntry (s);
+	struct PianoInternTable * const t = e->table;
+
+	assert (e->refs > 0);
+	if (--e->refs > 0) {
+		return;
+	}
+
+	if (t != NULL) {
+		const size_t mask = t->size - 1;
+		size_t i = e->hash & mask;
+
+		while (t->slots[i] != e) {
+			assert (t->slots[i] != NULL);
+			i = (i + 1) & mask;
+		}
+
+		/* backward shift deletion, see index.c */
+		size_t j = i;
+		while (true) {
+			j = (j + 1) & mask;
+			if (t->slots[j] == NULL) {
+				break;
+			}
+			const size_t k = t->slots[j]->hash & mask;
+			if ((i <= j) ? (i >= k || k > j) : (i >= k && k > j)) {
+				t->slots[i] = t->slots[j];
+				i = j;
+			}
+		}
+		t->slots[i] = NULL;
+		--t->used;
+	}
+
+	free (e);
+}
+
+/*	free table, strings still in use become standalone and are freed by
+ *	their last release
+ *	@param piano handle
+ */
+void PianoInternDestroy (PianoHandle_t * const ph) {
+	struct PianoInternTable * const t = ph->interned;
+
+	if (t == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < t->size; i++) {
+		if (t->slots[i] != NULL) {
+			t->slots[i]->table = NULL;
+		}
+	}
+	free (t->slots);
+	free (t);
+	ph->interned = NULL;
+}
@@ -110,3 +110,37 @@ size_t PianoListCount (const PianoListHead_t * const l) {
 	return count;
 }
 
+/*	start anchor at list l, which may be NULL; walks it once to find the tail
+ */
+void PianoListAnchorInit (PianoListAnchor_t * const a,
+		PianoListHead_t * const l) {
+	assert (a != NULL);
+
+	a->first = a->last = l;
+	a->count = 0;
+
+	PianoListHead_t *curr = l;
+	PianoListForeach (curr) {
+		a->last = curr;
+		++a->count;
+	}
+}
+
+/*	append element e to anchored list in constant time, return list head
+ */
+void *PianoListAnchorAppend (PianoListAnchor_t * const a,
+		PianoListHead_t * const e) {
+	assert (a != NULL);
+	assert (e != NULL);
+	assert (e->next == NULL);
+
+	if (a->last == NULL) {
+		a->first = e;
+	} else {
+		a->last->next = e;
+	}
+	a->last = e;
+	++a->count;
+
+	return a->first;
+}
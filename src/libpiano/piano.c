@@ -67,11 +67,16 @@ static void PianoDestroyArtists (PianoArtist_t *artists) {
 
 	curArtist = artists;
 	while (curArtist != NULL) {
-		free (curArtist->name);
-		free (curArtist->musicId);
-		free (curArtist->seedId);
 		lastArtist = curArtist;
 		curArtist = (PianoArtist_t *) curArtist->head.next;
+		if (lastArtist->arena != NULL) {
+			PianoInternRelease (lastArtist->name);
+			PianoArenaRelease (lastArtist->arena);
+			continue;
+		}
+		free (lastArtist->name);
+		free (lastArtist->musicId);
+		free (lastArtist->seedId);
 		free (lastArtist);
 	}
 }
@@ -85,14 +90,19 @@ void PianoDestroySearchResult (PianoSearchResult_t *searchResult) {
 	PianoDestroyPlaylist (searchResult->songs);
 }
 
-/*	free single station
+/*	free single station, which must not be part of a list anymore
  *	@param station
  */
 void PianoDestroyStation (PianoStation_t *station) {
+	if (station->arena != NULL) {
+		PianoInternRelease (station->id);
+		PianoArenaRelease (station->arena);
+		return;
+	}
 	free (station->name);
 	free (station->id);
 	free (station->seedId);
-	memset (station, 0, sizeof (*station));
+	free (station);
 }
 
 /*	free complete station list
@@ -106,7 +116,6 @@ static void PianoDestroyStations (PianoStation_t *stations) {
 		lastStation = curStation;
 		curStation = (PianoStation_t *) curStation->head.next;
 		PianoDestroyStation (lastStation);
-		free (lastStation);
 	}
 }
 
@@ -120,19 +129,26 @@ void PianoDestroyPlaylist (PianoSong_t *playlist) {
 
 	curSong = playlist;
 	while (curSong != NULL) {
-		free (curSong->audioUrl);
-		free (curSong->coverArt);
-		free (curSong->artist);
-		free (curSong->musicId);
-		free (curSong->title);
-		free (curSong->stationId);
-		free (curSong->album);
-		free (curSong->feedbackId);
-		free (curSong->seedId);
-		free (curSong->detailUrl);
-		free (curSong->trackToken);
 		lastSong = curSong;
 		curSong = (PianoSong_t *) curSong->head.next;
+		if (lastSong->arena != NULL) {
+			PianoInternRelease (lastSong->artist);
+			PianoInternRelease (lastSong->album);
+			PianoInternRelease (lastSong->stationId);
+			PianoArenaRelease (lastSong->arena);
+			continue;
+		}
+		free (lastSong->audioUrl);
+		free (lastSong->coverArt);
+		free (lastSong->artist);
+		free (lastSong->musicId);
+		free (lastSong->title);
+		free (lastSong->stationId);
+		free (lastSong->album);
+		free (lastSong->feedbackId);
+		free (lastSong->seedId);
+		free (lastSong->detailUrl);
+		free (lastSong->trackToken);
 		free (lastSong);
 	}
 }
@@ -164,6 +180,7 @@ static void PianoDestroyGenres (PianoGenre_t *genres) {
 void PianoDestroyUserInfo (PianoUserInfo_t *user) {
 	free (user->authToken);
 	free (user->listenerId);
+	free (user->urlParams);
 }
 
 /*	destroy partner
@@ -173,6 +190,7 @@ static void PianoDestroyPartner (PianoPartner_t *partner) {
 	free (partner->password);
 	free (partner->device);
 	free (partner->authToken);
+	free (partner->urlAuthToken);
 	PianoCryptDestroy (partner->in);
 	PianoCryptDestroy (partner->out);
 	memset (partner, 0, sizeof (*partner));
@@ -196,6 +214,8 @@ void PianoDestroyStationMode (PianoStationMode_t * const modes) {
  */
 void PianoDestroy (PianoHandle_t *ph) {
 	PianoDestroyUserInfo (&ph->user);
+	PianoIndexDestroy (ph);
+	PianoJsonWriterDestroy (&ph->writer);
 	PianoDestroyStations (ph->stations);
 	PianoDestroyPartner (&ph->partner);
 	/* destroy genre stations */
@@ -207,6 +227,8 @@ void PianoDestroy (PianoHandle_t *ph) {
 		curGenreCat = (PianoGenreCategory_t *) curGenreCat->head.next;
 		free (lastGenreCat);
 	}
+	/* songs in playlist and history may outlive the handle */
+	PianoInternDestroy (ph);
 	memset (ph, 0, sizeof (*ph));
 }
 
@@ -216,6 +238,8 @@ void PianoDestroy (PianoHandle_t *ph) {
  */
 void PianoDestroyRequest (PianoRequest_t *req) {
 	free (req->postData);
+	free (req->cacheKey);
+	PianoResponseReset (req);
 	memset (req, 0, sizeof (*req));
 }
 
@@ -41,6 +41,7 @@ THE SOFTWARE.
 #define PIANO_RPC_PATH "/services/json/?"
 
 typedef struct _PianoCipher_t* PianoCipher_t;
+typedef struct PianoArena PianoArena_t;
 
 typedef struct PianoListHead {
 	struct PianoListHead *next;
@@ -49,6 +50,8 @@ typedef struct PianoListHead {
 typedef struct PianoUserInfo {
 	char *listenerId;
 	char *authToken;
+	/* auth_token, partner_id and user_id url parameters, set on login */
+	char *urlParams;
 } PianoUserInfo_t;
 
 typedef struct PianoStation {
@@ -59,6 +62,8 @@ typedef struct PianoStation {
 	char *name;
 	char *id;
 	char *seedId;
+	/* owns node and strings, NULL if malloc'd; id is interned if set */
+	PianoArena_t *arena;
 } PianoStation_t;
 
 typedef enum {
@@ -99,6 +104,9 @@ typedef struct PianoSong {
 	unsigned int length; /* song length in seconds */
 	PianoSongRating_t rating;
 	PianoAudioFormat_t audioFormat;
+	/* owns node and strings, NULL if malloc'd; artist, album and stationId
+	 * are interned if set */
+	PianoArena_t *arena;
 } PianoSong_t;
 
 /* currently only used for search results */
@@ -108,6 +116,8 @@ typedef struct PianoArtist {
 	char *musicId;
 	char *seedId;
 	int score;
+	/* owns node and strings, NULL if malloc'd; name is interned if set */
+	PianoArena_t *arena;
 } PianoArtist_t;
 
 typedef struct PianoGenre {
@@ -125,16 +135,37 @@ typedef struct PianoGenreCategory {
 typedef struct PianoPartner {
 	PianoCipher_t in, out;
 	char *authToken, *device, *user, *password;
+	/* url-encoded authToken */
+	char *urlAuthToken;
 	unsigned int id;
 } PianoPartner_t;
 
+/* open addressing hash table of ph->stations, keyed by id */
+typedef struct PianoStationIndex {
+	PianoStation_t **slots;
+	size_t size, used;
+} PianoStationIndex_t;
+
+/* append-only json text, see writer.c */
+typedef struct PianoJsonWriter {
+	char *buf;
+	size_t length, capacity;
+	/* next value needs a separator, an allocation failed */
+	bool comma, failed;
+} PianoJsonWriter_t;
+
 typedef struct PianoHandle {
 	PianoUserInfo_t user;
 	/* linked lists */
 	PianoStation_t *stations;
+	PianoStationIndex_t stationIndex;
 	PianoGenreCategory_t *genreStations;
 	PianoPartner_t partner;
 	int timeOffset;
+	/* request bodies are built here, reused between requests */
+	PianoJsonWriter_t writer;
+	/* strings shared by songs, artists and stations, see intern.c */
+	struct PianoInternTable *interned;
 } PianoHandle_t;
 
 typedef struct PianoSearchResult {
@@ -195,7 +226,19 @@ typedef struct PianoRequest {
 	void *data;
 	char urlPath[1024];
 	char *postData;
+	/* same for requests with the same answer, NULL unless the request is
+	 * read-only */
+	char *cacheKey;
 	char *responseData;
+	/* length of responseData, excluding terminating NUL */
+	size_t responseDataSize;
+	/* response parsed while it was received, see PianoResponseFeed; large
+	 * responses go straight into lists (responseStream), others into a
+	 * json-c document */
+	struct json_tokener *responseParser;
+	struct json_object *responseJson;
+	struct PianoResponseStream *responseStream;
+	bool responseParseFailed;
 } PianoRequest_t;
 
 /* request data structures */
@@ -366,6 +409,20 @@ void *PianoListGet (PianoListHead_t * const l, const size_t n);
 #define PianoListGetP(l,n) PianoListGet (&(l)->head, n)
 #define PianoListForeachP(l) for (; (l) != NULL; (l) = (void *) (l)->head.next)
 
+/* builds a list front to back without walking it for every element */
+typedef struct PianoListAnchor {
+	PianoListHead_t *first, *last;
+	size_t count;
+} PianoListAnchor_t;
+
+void PianoListAnchorInit (PianoListAnchor_t * const, PianoListHead_t * const);
+#define PianoListAnchorInitP(a,l) PianoListAnchorInit (a, ((l) == NULL) ? NULL : \
+		&(l)->head)
+void *PianoListAnchorAppend (PianoListAnchor_t * const,
+		PianoListHead_t * const);
+#define PianoListAnchorAppendP(a,e) PianoListAnchorAppend (a, &(e)->head)
+#define PianoListAnchorCount(a) ((a)->count)
+
 /* memory management */
 PianoReturn_t PianoInit (PianoHandle_t *, const char *,
 		const char *, const char *, const char *,
@@ -380,10 +437,14 @@ void PianoDestroyStationMode (PianoStationMode_t * const);
 PianoReturn_t PianoRequest (PianoHandle_t *, PianoRequest_t *,
 		PianoRequestType_t);
 PianoReturn_t PianoResponse (PianoHandle_t *, PianoRequest_t *);
+void PianoResponseFeed (PianoRequest_t *, const char *, size_t);
+void PianoResponseReset (PianoRequest_t *);
 void PianoDestroyRequest (PianoRequest_t *);
 
 /* misc */
 PianoStation_t *PianoFindStationById (PianoStation_t * const,
 		const char * const);
+PianoStation_t *PianoGetStationById (const PianoHandle_t * const,
+		const char * const);
 const char *PianoErrorToStr (PianoReturn_t);
 
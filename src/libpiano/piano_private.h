@@ -23,8 +23,89 @@ THE SOFTWARE.
 
 #pragma once
 
+#include <stdint.h>
+
 #include "piano.h"
 
 void PianoDestroyStation (PianoStation_t *station);
 void PianoDestroyUserInfo (PianoUserInfo_t *user);
+char *PianoUrlEncode (const char * const);
+
+PianoArena_t *PianoArenaNew (void);
+void *PianoArenaAlloc (PianoArena_t * const, size_t);
+char *PianoArenaStrdup (PianoArena_t * const, const char * const);
+void *PianoArenaNode (PianoArena_t * const, const size_t);
+void PianoArenaRetain (PianoArena_t * const);
+void PianoArenaRelease (PianoArena_t * const);
+
+void PianoIndexAdd (PianoHandle_t * const, PianoStation_t * const);
+void PianoIndexRemove (PianoHandle_t * const, PianoStation_t * const);
+void PianoIndexDestroy (PianoHandle_t * const);
+size_t PianoHashString (const char *);
+
+char *PianoIntern (PianoHandle_t * const, const char * const);
+void PianoInternRelease (char * const);
+void PianoInternDestroy (PianoHandle_t * const);
+
+void PianoJsonWriterReset (PianoJsonWriter_t * const);
+void PianoJsonWriterDestroy (PianoJsonWriter_t * const);
+void PianoJsonBeginObject (PianoJsonWriter_t * const, const char * const);
+void PianoJsonEndObject (PianoJsonWriter_t * const);
+void PianoJsonBeginArray (PianoJsonWriter_t * const, const char * const);
+void PianoJsonEndArray (PianoJsonWriter_t * const);
+void PianoJsonAddString (PianoJsonWriter_t * const, const char * const,
+		const char * const);
+void PianoJsonAddBool (PianoJsonWriter_t * const, const char * const,
+		const bool);
+void PianoJsonAddInt (PianoJsonWriter_t * const, const char * const,
+		const int64_t);
+
+/* containers the reader follows, deeper documents are rejected */
+#define PIANO_JSON_READER_DEPTH 16
+/* longer keys are stored as "" */
+#define PIANO_JSON_READER_KEY 32
+
+typedef enum {
+	/* chunk used up, feed the next one */
+	PIANO_JSON_MORE = 0,
+	PIANO_JSON_ERROR,
+	PIANO_JSON_BEGIN_OBJECT,
+	PIANO_JSON_END_OBJECT,
+	PIANO_JSON_BEGIN_ARRAY,
+	PIANO_JSON_END_ARRAY,
+	PIANO_JSON_STRING,
+	PIANO_JSON_NUMBER,
+	PIANO_JSON_TRUE,
+	PIANO_JSON_FALSE,
+	PIANO_JSON_NULL,
+} PianoJsonEvent_t;
+
+/* incremental json tokenizer, see reader.c */
+typedef struct PianoJsonReader {
+	/* containers around the current event, outermost first; key is the
+	 * member of an object that is being read */
+	struct {
+		bool array;
+		char key[PIANO_JSON_READER_KEY];
+	} frame[PIANO_JSON_READER_DEPTH];
+	size_t depth;
+	/* text of the last scalar, NUL-terminated */
+	char *text;
+	size_t length, capacity;
+	int state;
+	/* string being read is a key, container opened by the last event */
+	bool key, push, pushArray;
+	/* \u escape being read and high surrogate waiting for its pair */
+	unsigned int hexDigits;
+	unsigned long codePoint, highSurrogate;
+	/* top-level value complete */
+	bool done;
+} PianoJsonReader_t;
+
+void PianoJsonReaderInit (PianoJsonReader_t * const);
+void PianoJsonReaderDestroy (PianoJsonReader_t * const);
+PianoJsonEvent_t PianoJsonRead (PianoJsonReader_t * const,
+		const char ** const, size_t * const);
+bool PianoJsonReaderIn (const PianoJsonReader_t * const,
+		const char * const * const, const size_t);
 
@@ -0,0 +1,508 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "../config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "piano_private.h"
+
+/* first allocation, enough for most strings */
+#define PIANO_JSON_READER_MIN 64
+
+/* what the next character may be */
+typedef enum {
+	PIANO_JSON_STATE_VALUE = 0,
+	/* right after [ */
+	PIANO_JSON_STATE_VALUE_OR_END,
+	PIANO_JSON_STATE_KEY,
+	/* right after { */
+	PIANO_JSON_STATE_KEY_OR_END,
+	PIANO_JSON_STATE_COLON,
+	/* separator or end of container */
+	PIANO_JSON_STATE_AFTER,
+	PIANO_JSON_STATE_STRING,
+	PIANO_JSON_STATE_ESCAPE,
+	PIANO_JSON_STATE_UNICODE,
+	/* \ and u of the low surrogate's escape */
+	PIANO_JSON_STATE_SURROGATE_ESCAPE,
+	PIANO_JSON_STATE_SURROGATE_U,
+	/* number, true, false or null */
+	PIANO_JSON_STATE_LITERAL,
+	PIANO_JSON_STATE_DONE,
+	PIANO_JSON_STATE_FAILED,
+} PianoJsonState_t;
+
+void PianoJsonReaderInit (PianoJsonReader_t * const r) {
+	assert (r != NULL);
+
+	memset (r, 0, sizeof (*r));
+	r->state = PIANO_JSON_STATE_VALUE;
+}
+
+void PianoJsonReaderDestroy (PianoJsonReader_t * const r) {
+	assert (r != NULL);
+
+	free (r->text);
+	memset (r, 0, sizeof (*r));
+}
+
+/*	append character to text
+ *	@return false if out of memory
+ */
+static bool PianoJsonReaderPut (PianoJsonReader_t * const r, const char c) {
+	if (r->length + 2 > r->capacity) {
+		const size_t capacity = r->capacity > 0 ? r->capacity * 2 :
+				PIANO_JSON_READER_MIN;
+		char * const text = realloc (r->text, capacity);
+		if (text == NULL) {
+			return false;
+		}
+		r->text = text;
+		r->capacity = capacity;
+	}
+
+	r->text[r->length++] = c;
+	r->text[r->length] = '\0';
+	return true;
+}
+
+/*	append code point as utf-8, like json-c does
+ *	@return false if out of memory
+ */
+static bool PianoJsonReaderPutUtf8 (PianoJsonReader_t * const r,
+		const unsigned long cp) {
+	if (cp < 0x80) {
+		return PianoJsonReaderPut (r, (char) cp);
+	} else if (cp < 0x800) {
+		return PianoJsonReaderPut (r, (char) (0xc0 | (cp >> 6))) &&
+				PianoJsonReaderPut (r, (char) (0x80 | (cp & 0x3f)));
+	} else if (cp < 0x10000) {
+		return PianoJsonReaderPut (r, (char) (0xe0 | (cp >> 12))) &&
+				PianoJsonReaderPut (r, (char) (0x80 | ((cp >> 6) & 0x3f))) &&
+				PianoJsonReaderPut (r, (char) (0x80 | (cp & 0x3f)));
+	} else {
+		return PianoJsonReaderPut (r, (char) (0xf0 | (cp >> 18))) &&
+				PianoJsonReaderPut (r, (char) (0x80 | ((cp >> 12) & 0x3f))) &&
+				PianoJsonReaderPut (r, (char) (0x80 | ((cp >> 6) & 0x3f))) &&
+				PianoJsonReaderPut (r, (char) (0x80 | (cp & 0x3f)));
+	}
+}
+
+/*	start text of the next token, text is never NULL afterwards
+ *	@return false if out of memory
+ */
+static bool PianoJsonReaderClear (PianoJsonReader_t * const r) {
+	if (r->text == NULL && !PianoJsonReaderPut (r, '\0')) {
+		return false;
+	}
+	r->length = 0;
+	r->text[0] = '\0';
+	return true;
+}
+
+static bool PianoJsonIsSpace (const char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool PianoJsonIsDigit (const char c) {
+	return c >= '0' && c <= '9';
+}
+
+/*	check number against json's grammar, strtod accepts more
+ */
+static bool PianoJsonIsNumber (const char *s) {
+	if (*s == '-') {
+		++s;
+	}
+	if (*s == '0') {
+		++s;
+	} else if (PianoJsonIsDigit (*s)) {
+		while (PianoJsonIsDigit (*s)) {
+			++s;
+		}
+	} else {
+		return false;
+	}
+	if (*s == '.') {
+		++s;
+		if (!PianoJsonIsDigit (*s)) {
+			return false;
+		}
+		while (PianoJsonIsDigit (*s)) {
+			++s;
+		}
+	}
+	if (*s == 'e' || *s == 'E') {
+		++s;
+		if (*s == '+' || *s == '-') {
+			++s;
+		}
+		if (!PianoJsonIsDigit (*s)) {
+			return false;
+		}
+		while (PianoJsonIsDigit (*s)) {
+			++s;
+		}
+	}
+	return *s == '\0';
+}
+
+/*	scalar complete, a separator or the end of its container follows
+ */
+static void PianoJsonReaderValueDone (PianoJsonReader_t * const r) {
+	if (r->depth == 0) {
+		r->state = PIANO_JSON_STATE_DONE;
+		r->done = true;
+	} else {
+		r->state = PIANO_JSON_STATE_AFTER;
+	}
+}
+
+/*	first character of a value
+ */
+static PianoJsonEvent_t PianoJsonReaderBegin (PianoJsonReader_t * const r,
+		const char c) {
+	switch (c) {
+		case '{':
+		case '[':
+			if (r->depth >= PIANO_JSON_READER_DEPTH) {
+				return PIANO_JSON_ERROR;
+			}
+			/* container is entered with the next call, so the event is
+			 * reported where the container itself is */
+			r->push = true;
+			r->pushArray = c == '[';
+			return c == '[' ? PIANO_JSON_BEGIN_ARRAY :
+					PIANO_JSON_BEGIN_OBJECT;
+
+		case '"':
+			r->key = false;
+			r->state = PIANO_JSON_STATE_STRING;
+			return PianoJsonReaderClear (r) ? PIANO_JSON_MORE :
+					PIANO_JSON_ERROR;
+
+		default:
+			if (c == '-' || PianoJsonIsDigit (c) || c == 't' || c == 'f' ||
+					c == 'n') {
+				r->state = PIANO_JSON_STATE_LITERAL;
+				return PianoJsonReaderClear (r) && PianoJsonReaderPut (r, c) ?
+						PIANO_JSON_MORE : PIANO_JSON_ERROR;
+			}
+			return PIANO_JSON_ERROR;
+	}
+}
+
+/*	leave container, which must be of the given type
+ */
+static PianoJsonEvent_t PianoJsonReaderEnd (PianoJsonReader_t * const r,
+		const bool array) {
+	if (r->depth == 0 || r->frame[r->depth-1].array != array) {
+		return PIANO_JSON_ERROR;
+	}
+
+	--r->depth;
+	PianoJsonReaderValueDone (r);
+	return array ? PIANO_JSON_END_ARRAY : PIANO_JSON_END_OBJECT;
+}
+
+/*	closing quote, keys are kept in the container's frame
+ */
+static PianoJsonEvent_t PianoJsonReaderEndString (
+		PianoJsonReader_t * const r) {
+	if (r->key) {
+		char * const key = r->frame[r->depth-1].key;
+		if (r->length < PIANO_JSON_READER_KEY) {
+			memcpy (key, r->text, r->length + 1);
+		} else {
+			key[0] = '\0';
+		}
+		r->state = PIANO_JSON_STATE_COLON;
+		return PIANO_JSON_MORE;
+	}
+
+	PianoJsonReaderValueDone (r);
+	return PIANO_JSON_STRING;
+}
+
+/*	four hex digits read, pairs surrogates
+ */
+static PianoJsonEvent_t PianoJsonReaderEndUnicode (
+		PianoJsonReader_t * const r) {
+	unsigned long cp = r->codePoint;
+
+	if (r->highSurrogate != 0) {
+		if (cp < 0xdc00 || cp > 0xdfff) {
+			return PIANO_JSON_ERROR;
+		}
+		cp = 0x10000 + ((r->highSurrogate - 0xd800) << 10) + (cp - 0xdc00);
+		r->highSurrogate = 0;
+	} else if (cp >= 0xd800 && cp <= 0xdbff) {
+		r->highSurrogate = cp;
+		r->state = PIANO_JSON_STATE_SURROGATE_ESCAPE;
+		return PIANO_JSON_MORE;
+	} else if (cp >= 0xdc00 && cp <= 0xdfff) {
+		return PIANO_JSON_ERROR;
+	}
+
+	r->state = PIANO_JSON_STATE_STRING;
+	return PianoJsonReaderPutUtf8 (r, cp) ? PIANO_JSON_MORE :
+			PIANO_JSON_ERROR;
+}
+
+/*	number or keyword ended by the character following it
+ */
+static PianoJsonEvent_t PianoJsonReaderEndLiteral (
+		PianoJsonReader_t * const r) {
+	PianoJsonEvent_t event;
+
+	if (strcmp (r->text, "true") == 0) {
+		event = PIANO_JSON_TRUE;
+	} else if (strcmp (r->text, "false") == 0) {
+		event = PIANO_JSON_FALSE;
+	} else if (strcmp (r->text, "null") == 0) {
+		event = PIANO_JSON_NULL;
+	} else if (PianoJsonIsNumber (r->text)) {
+		event = PIANO_JSON_NUMBER;
+	} else {
+		return PIANO_JSON_ERROR;
+	}
+
+	PianoJsonReaderValueDone (r);
+	return event;
+}
+
+/*	read from chunk until the next event
+ *	@param reader
+ *	@param chunk, advanced past the characters read
+ *	@param size of chunk, decreased accordingly
+ *	@return event, PIANO_JSON_MORE if the chunk is used up; the position of
+ *		the event is frame[0..depth-1], the text of scalars is in text
+ */
+PianoJsonEvent_t PianoJsonRead (PianoJsonReader_t * const r,
+		const char ** const data, size_t * const size) {
+	assert (r != NULL);
+	assert (data != NULL);
+	assert (size != NULL);
+
+	if (r->push) {
+		r->frame[r->depth].array = r->pushArray;
+		r->frame[r->depth].key[0] = '\0';
+		++r->depth;
+		r->push = false;
+		r->state = r->pushArray ? PIANO_JSON_STATE_VALUE_OR_END :
+				PIANO_JSON_STATE_KEY_OR_END;
+	}
+
+	while (*size > 0) {
+		const char c = **data;
+		PianoJsonEvent_t event = PIANO_JSON_MORE;
+		bool consume = true;
+
+		switch (r->state) {
+			case PIANO_JSON_STATE_VALUE:
+			case PIANO_JSON_STATE_VALUE_OR_END:
+				if (PianoJsonIsSpace (c)) {
+					break;
+				}
+				if (c == ']' && r->state == PIANO_JSON_STATE_VALUE_OR_END) {
+					event = PianoJsonReaderEnd (r, true);
+				} else {
+					event = PianoJsonReaderBegin (r, c);
+				}
+				break;
+
+			case PIANO_JSON_STATE_KEY:
+			case PIANO_JSON_STATE_KEY_OR_END:
+				if (PianoJsonIsSpace (c)) {
+					break;
+				}
+				if (c == '}' && r->state == PIANO_JSON_STATE_KEY_OR_END) {
+					event = PianoJsonReaderEnd (r, false);
+				} else if (c == '"') {
+					r->key = true;
+					r->state = PIANO_JSON_STATE_STRING;
+					if (!PianoJsonReaderClear (r)) {
+						event = PIANO_JSON_ERROR;
+					}
+				} else {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+
+			case PIANO_JSON_STATE_COLON:
+				if (PianoJsonIsSpace (c)) {
+					break;
+				}
+				if (c == ':') {
+					r->state = PIANO_JSON_STATE_VALUE;
+				} else {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+
+			case PIANO_JSON_STATE_AFTER:
+				if (PianoJsonIsSpace (c)) {
+					break;
+				}
+				if (c == ',') {
+					r->state = r->frame[r->depth-1].array ?
+							PIANO_JSON_STATE_VALUE : PIANO_JSON_STATE_KEY;
+				} else if (c == ']' || c == '}') {
+					event = PianoJsonReaderEnd (r, c == ']');
+				} else {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+
+			case PIANO_JSON_STATE_STRING:
+				if (c == '"') {
+					event = PianoJsonReaderEndString (r);
+				} else if (c == '\\') {
+					r->state = PIANO_JSON_STATE_ESCAPE;
+				} else if ((unsigned char) c < 0x20 ||
+						!PianoJsonReaderPut (r, c)) {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+
+			case PIANO_JSON_STATE_ESCAPE: {
+				static const char escaped[] = "\"\\/bfnrt";
+				static const char unescaped[] = "\"\\/\b\f\n\r\t";
+				const char * const e = c != '\0' ? strchr (escaped, c) : NULL;
+
+				if (c == 'u') {
+					r->hexDigits = 0;
+					r->codePoint = 0;
+					r->state = PIANO_JSON_STATE_UNICODE;
+				} else if (e != NULL && PianoJsonReaderPut (r,
+						unescaped[e - escaped])) {
+					r->state = PIANO_JSON_STATE_STRING;
+				} else {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+			}
+
+			case PIANO_JSON_STATE_UNICODE: {
+				unsigned int digit;
+
+				if (PianoJsonIsDigit (c)) {
+					digit = (unsigned int) (c - '0');
+				} else if (c >= 'a' && c <= 'f') {
+					digit = (unsigned int) (c - 'a' + 10);
+				} else if (c >= 'A' && c <= 'F') {
+					digit = (unsigned int) (c - 'A' + 10);
+				} else {
+					event = PIANO_JSON_ERROR;
+					break;
+				}
+				r->codePoint = r->codePoint * 16 + digit;
+				if (++r->hexDigits == 4) {
+					event = PianoJsonReaderEndUnicode (r);
+				}
+				break;
+			}
+
+			case PIANO_JSON_STATE_SURROGATE_ESCAPE:
+				if (c == '\\') {
+					r->state = PIANO_JSON_STATE_SURROGATE_U;
+				} else {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+
+			case PIANO_JSON_STATE_SURROGATE_U:
+				if (c == 'u') {
+					r->hexDigits = 0;
+					r->codePoint = 0;
+					r->state = PIANO_JSON_STATE_UNICODE;
+				} else {
+					event = PIANO_JSON_ERROR;
+				}
+				break;
+
+			case PIANO_JSON_STATE_LITERAL:
+				if (PianoJsonIsDigit (c) || (c >= 'a' && c <= 'z') ||
+						(c >= 'A' && c <= 'Z') || c == '+' || c == '-' ||
+						c == '.') {
+					if (!PianoJsonReaderPut (r, c)) {
+						event = PIANO_JSON_ERROR;
+					}
+				} else {
+					/* belongs to whatever follows */
+					consume = false;
+					event = PianoJsonReaderEndLiteral (r);
+				}
+				break;
+
+			case PIANO_JSON_STATE_DONE:
+				/* anything after the document is none of our business */
+				*data += *size;
+				*size = 0;
+				return PIANO_JSON_MORE;
+
+			default:
+				return PIANO_JSON_ERROR;
+		}
+
+		if (consume) {
+			++*data;
+			--*size;
+		}
+		if (event == PIANO_JSON_ERROR) {
+			r->state = PIANO_JSON_STATE_FAILED;
+			return PIANO_JSON_ERROR;
+		}
+		if (event != PIANO_JSON_MORE) {
+			return event;
+		}
+	}
+
+	return PIANO_JSON_MORE;
+}
+
+/*	check where the last event is
+ *	@param reader
+ *	@param member name for each of the outermost containers, NULL for arrays
+ *	@param number of containers to check
+ *	@return true if the event is inside them
+ */
+bool PianoJsonReaderIn (const PianoJsonReader_t * const r,
+		const char * const * const path, const size_t depth) {
+	assert (r != NULL);
+	assert (path != NULL);
+
+	if (r->depth < depth) {
+		return false;
+	}
+	for (size_t i = 0; i < depth; i++) {
+		if (path[i] == NULL ? !r->frame[i].array : (r->frame[i].array ||
+				strcmp (r->frame[i].key, path[i]) != 0)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -23,58 +23,89 @@ THE SOFTWARE.
 
 #include "../config.h"
 
-#include <json/json.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 
-#include "piano.h"
+#include "piano_private.h"
 #include "crypt.h"
 
-static char* PianoEncodeAuthToken(const char* token)
-{
-	/* Pandora expects '+' and '=' to be escaped. */
-	const char* allowed = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-~._";
-	const char* hex     = "0123456789ABCDEF";
-
-	size_t i, tokenSize, resultSize, resultCapacity;
-	char* result;
-
-	tokenSize      = strlen(token);
-	resultSize     = 0;
-	resultCapacity = tokenSize * 3 / 2;
-	result         = malloc(resultCapacity);
-	for (i = 0; i < tokenSize; ++i) {
-		char cp = token[i];
-		
-		int c = (strchr(allowed, cp) != NULL) ? 1 : 3;
-
-		if (resultSize + c >= resultCapacity) {
-			resultCapacity = resultCapacity * 3 / 2;
-			result = realloc(result, resultCapacity);
-		}
+/* unreserved characters of rfc 3986, Pandora expects everything else,
+ * including '+' and '=', to be escaped */
+static const bool urlUnreserved[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/*	percent-encode string, done once per login for the auth tokens
+ *	@param string
+ *	@return encoded copy or NULL if out of memory
+ */
+char *PianoUrlEncode (const char * const s) {
+	static const char hex[] = "0123456789ABCDEF";
+	const unsigned char *c;
+	size_t size = 1;
+	char *result, *out;
 
-		if (c == 1) {
-			result[resultSize++] = cp;
-		}
-		else {
-			result[resultSize++] = '%';
-			result[resultSize++] = hex[(cp >> 4) & 0x0F];
-			result[resultSize++] = hex[(cp >> 0) & 0x0F];
-		}
+	assert (s != NULL);
+
+	for (c = (const unsigned char *) s; *c != '\0'; c++) {
+		size += urlUnreserved[*c] ? 1 : 3;
 	}
 
-	if (resultSize + 1 >= resultCapacity) {
-		resultCapacity = resultSize + 1;
-		result = realloc(result, resultCapacity);
+	if ((result = malloc (size)) == NULL) {
+		return NULL;
 	}
 
-	result[resultSize] = 0;
+	out = result;
+	for (c = (const unsigned char *) s; *c != '\0'; c++) {
+		if (urlUnreserved[*c]) {
+			*out++ = (char) *c;
+		} else {
+			*out++ = '%';
+			*out++ = hex[*c >> 4];
+			*out++ = hex[*c & 0x0f];
+		}
+	}
+	*out = '\0';
 
 	return result;
 }
 
+/*	requests whose answer only depends on their parameters, as long as no
+ *	other request changes anything in between
+ */
+static bool PianoRequestIsReadOnly (PianoRequestType_t type) {
+	switch (type) {
+		case PIANO_REQUEST_GET_STATIONS:
+		case PIANO_REQUEST_SEARCH:
+		case PIANO_REQUEST_GET_GENRE_STATIONS:
+		case PIANO_REQUEST_EXPLAIN:
+		case PIANO_REQUEST_GET_STATION_INFO:
+		case PIANO_REQUEST_GET_SETTINGS:
+		case PIANO_REQUEST_GET_STATION_MODES:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
 /*	prepare piano request (initializes request type, urlpath and postData)
  *	@param piano handle
  *	@param request structure
@@ -83,9 +114,9 @@ static char* PianoEncodeAuthToken(const char* token)
 PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 		PianoRequestType_t type) {
 	PianoReturn_t ret = PIANO_RET_OK;
-	const char *jsonSendBuf;
 	const char *method = NULL;
-	json_object *j = json_object_new_object ();
+	/* body is built in place, no json-c objects */
+	PianoJsonWriter_t * const w = &ph->writer;
 	/* corrected timestamp */
 	time_t timestamp = time (NULL) - ph->timeOffset;
 	bool encrypted = true;
@@ -97,6 +128,9 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 	/* no tls by default */
 	req->secure = false;
 
+	PianoJsonWriterReset (w);
+	PianoJsonBeginObject (w, NULL);
+
 	switch (req->type) {
 		case PIANO_REQUEST_LOGIN: {
 			/* authenticate user */
@@ -109,43 +143,32 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					encrypted = false;
 					req->secure = true;
 
-					json_object_object_add (j, "username",
-							json_object_new_string (ph->partner.user));
-					json_object_object_add (j, "password",
-							json_object_new_string (ph->partner.password));
-					json_object_object_add (j, "deviceModel",
-							json_object_new_string (ph->partner.device));
-					json_object_object_add (j, "version",
-							json_object_new_string ("5"));
-					json_object_object_add (j, "includeUrls",
-							json_object_new_boolean (true));
+					PianoJsonAddString (w, "username", ph->partner.user);
+					PianoJsonAddString (w, "password", ph->partner.password);
+					PianoJsonAddString (w, "deviceModel", ph->partner.device);
+					PianoJsonAddString (w, "version", "5");
+					PianoJsonAddBool (w, "includeUrls", true);
 					snprintf (req->urlPath, sizeof (req->urlPath),
 							PIANO_RPC_PATH "method=auth.partnerLogin");
 					break;
 
 				case 1: {
-					char *urlencAuthToken;
-
 					req->secure = true;
 
-					json_object_object_add (j, "loginType",
-							json_object_new_string ("user"));
-					json_object_object_add (j, "username",
-							json_object_new_string (logindata->user));
-					json_object_object_add (j, "password",
-							json_object_new_string (logindata->password));
-					json_object_object_add (j, "partnerAuthToken",
-							json_object_new_string (ph->partner.authToken));
-					json_object_object_add (j, "syncTime",
-							json_object_new_int64 (timestamp));
-
-					urlencAuthToken = PianoEncodeAuthToken (ph->partner.authToken);
-					assert (urlencAuthToken != NULL);
+					PianoJsonAddString (w, "loginType", "user");
+					PianoJsonAddString (w, "username", logindata->user);
+					PianoJsonAddString (w, "password", logindata->password);
+					PianoJsonAddString (w, "partnerAuthToken",
+							ph->partner.authToken);
+					PianoJsonAddInt (w, "syncTime", timestamp);
+
+					if (ph->partner.urlAuthToken == NULL) {
+						return PIANO_RET_OUT_OF_MEMORY;
+					}
 					snprintf (req->urlPath, sizeof (req->urlPath),
 							PIANO_RPC_PATH "method=auth.userLogin&"
-							"auth_token=%s&partner_id=%i", urlencAuthToken,
-							ph->partner.id);
-					free (urlencAuthToken);
+							"auth_token=%s&partner_id=%u",
+							ph->partner.urlAuthToken, ph->partner.id);
 
 					break;
 				}
@@ -157,8 +180,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			/* get stations, user must be authenticated */
 			assert (ph->user.listenerId != NULL);
 
-			json_object_object_add (j, "returnAllStations",
-					json_object_new_boolean (true));
+			PianoJsonAddBool (w, "returnAllStations", true);
 
 			method = "user.getStationList";
 			break;
@@ -174,10 +196,8 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			req->secure = true;
 
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (reqData->station->id));
-			json_object_object_add (j, "includeTrackLength",
-					json_object_new_boolean (true));
+			PianoJsonAddString (w, "stationToken", reqData->station->id);
+			PianoJsonAddBool (w, "includeTrackLength", true);
 
 			method = "station.getPlaylist";
 			break;
@@ -193,12 +213,10 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->rating != PIANO_RATE_NONE &&
 					reqData->rating != PIANO_RATE_TIRED);
 
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (reqData->stationId));
-			json_object_object_add (j, "trackToken",
-					json_object_new_string (reqData->trackToken));
-			json_object_object_add (j, "isPositive",
-					json_object_new_boolean (reqData->rating == PIANO_RATE_LOVE));
+			PianoJsonAddString (w, "stationToken", reqData->stationId);
+			PianoJsonAddString (w, "trackToken", reqData->trackToken);
+			PianoJsonAddBool (w, "isPositive",
+					reqData->rating == PIANO_RATE_LOVE);
 
 			method = "station.addFeedback";
 			break;
@@ -211,10 +229,8 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->station != NULL);
 			assert (reqData->newName != NULL);
 
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (reqData->station->id));
-			json_object_object_add (j, "stationName",
-					json_object_new_string (reqData->newName));
+			PianoJsonAddString (w, "stationToken", reqData->station->id);
+			PianoJsonAddString (w, "stationName", reqData->newName);
 
 			method = "station.renameStation";
 			break;
@@ -227,8 +243,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (station != NULL);
 			assert (station->id != NULL);
 
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (station->id));
+			PianoJsonAddString (w, "stationToken", station->id);
 
 			method = "station.deleteStation";
 			break;
@@ -241,8 +256,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData != NULL);
 			assert (reqData->searchStr != NULL);
 
-			json_object_object_add (j, "searchText",
-					json_object_new_string (reqData->searchStr));
+			PianoJsonAddString (w, "searchText", reqData->searchStr);
 
 			method = "music.search";
 			break;
@@ -256,20 +270,16 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->token != NULL);
 
 			if (reqData->type == PIANO_MUSICTYPE_INVALID) {
-				json_object_object_add (j, "musicToken",
-						json_object_new_string (reqData->token));
+				PianoJsonAddString (w, "musicToken", reqData->token);
 			} else {
-				json_object_object_add (j, "trackToken",
-						json_object_new_string (reqData->token));
+				PianoJsonAddString (w, "trackToken", reqData->token);
 				switch (reqData->type) {
 					case PIANO_MUSICTYPE_SONG:
-						json_object_object_add (j, "musicType",
-								json_object_new_string ("song"));
+						PianoJsonAddString (w, "musicType", "song");
 						break;
 
 					case PIANO_MUSICTYPE_ARTIST:
-						json_object_object_add (j, "musicType",
-								json_object_new_string ("artist"));
+						PianoJsonAddString (w, "musicType", "artist");
 						break;
 
 					default:
@@ -290,10 +300,8 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->station != NULL);
 			assert (reqData->musicId != NULL);
 
-			json_object_object_add (j, "musicToken",
-					json_object_new_string (reqData->musicId));
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (reqData->station->id));
+			PianoJsonAddString (w, "musicToken", reqData->musicId);
+			PianoJsonAddString (w, "stationToken", reqData->station->id);
 
 			method = "station.addMusic";
 			break;
@@ -305,8 +313,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			json_object_object_add (j, "trackToken",
-					json_object_new_string (song->trackToken));
+			PianoJsonAddString (w, "trackToken", song->trackToken);
 
 			method = "user.sleepSong";
 			break;
@@ -316,17 +323,15 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			/* select stations included in quickmix (see useQuickMix flag of
 			 * PianoStation_t) */
 			PianoStation_t *curStation = ph->stations;
-			json_object *a = json_object_new_array ();
 
+			PianoJsonBeginArray (w, "quickMixStationIds");
 			PianoListForeachP (curStation) {
 				/* quick mix can't contain itself */
 				if (curStation->useQuickMix && !curStation->isQuickMix) {
-					json_object_array_add (a,
-							json_object_new_string (curStation->id));
+					PianoJsonAddString (w, NULL, curStation->id);
 				}
 			}
-
-			json_object_object_add (j, "quickMixStationIds", a);
+			PianoJsonEndArray (w);
 
 			method = "user.setQuickMix";
 			break;
@@ -344,8 +349,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (station != NULL);
 
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (station->id));
+			PianoJsonAddString (w, "stationToken", station->id);
 
 			method = "station.transformSharedStation";
 			break;
@@ -358,8 +362,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData != NULL);
 			assert (reqData->song != NULL);
 
-			json_object_object_add (j, "trackToken",
-					json_object_new_string (reqData->song->trackToken));
+			PianoJsonAddString (w, "trackToken", reqData->song->trackToken);
 
 			method = "track.explainTrack";
 			break;
@@ -371,8 +374,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			json_object_object_add (j, "trackToken",
-					json_object_new_string (song->trackToken));
+			PianoJsonAddString (w, "trackToken", song->trackToken);
 
 			method = "bookmark.addSongBookmark";
 			break;
@@ -384,8 +386,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			json_object_object_add (j, "trackToken",
-					json_object_new_string (song->trackToken));
+			PianoJsonAddString (w, "trackToken", song->trackToken);
 
 			method = "bookmark.addArtistBookmark";
 			break;
@@ -398,12 +399,9 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData != NULL);
 			assert (reqData->station != NULL);
 
-			json_object_object_add (j, "stationToken",
-					json_object_new_string (reqData->station->id));
-			json_object_object_add (j, "includeExtendedAttributes",
-					json_object_new_boolean (true));
-			json_object_object_add (j, "includeExtraParams",
-					json_object_new_boolean (true));
+			PianoJsonAddString (w, "stationToken", reqData->station->id);
+			PianoJsonAddBool (w, "includeExtendedAttributes", true);
+			PianoJsonAddBool (w, "includeExtraParams", true);
 
 			method = "station.getStation";
 			break;
@@ -415,8 +413,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			PianoStation_t * const station = reqData->station;
 			assert (station != NULL);
 
-			json_object_object_add (j, "stationId",
-					json_object_new_string (station->id));
+			PianoJsonAddString (w, "stationId", station->id);
 
 			method = "interactiveradio.v1.getAvailableModesSimple";
 			req->secure = true;
@@ -429,10 +426,8 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			PianoStation_t * const station = reqData->station;
 			assert (station != NULL);
 
-			json_object_object_add (j, "stationId",
-					json_object_new_string (station->id));
-			json_object_object_add (j, "modeId",
-					json_object_new_int (reqData->id));
+			PianoJsonAddString (w, "stationId", station->id);
+			PianoJsonAddInt (w, "modeId", reqData->id);
 
 			method = "interactiveradio.v1.setAndGetAvailableModes";
 			req->secure = true;
@@ -444,8 +439,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			json_object_object_add (j, "feedbackId",
-					json_object_new_string (song->feedbackId));
+			PianoJsonAddString (w, "feedbackId", song->feedbackId);
 
 			method = "station.deleteFeedback";
 			break;
@@ -469,8 +463,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (seedId != NULL);
 
-			json_object_object_add (j, "seedId",
-					json_object_new_string (seedId));
+			PianoJsonAddString (w, "seedId", seedId);
 
 			method = "station.deleteMusic";
 			break;
@@ -487,23 +480,18 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->currentPassword != NULL);
 			assert (reqData->currentUsername != NULL);
 
-			json_object_object_add (j, "userInitiatedChange",
-					json_object_new_boolean (true));
-			json_object_object_add (j, "currentUsername",
-					json_object_new_string (reqData->currentUsername));
-			json_object_object_add (j, "currentPassword",
-					json_object_new_string (reqData->currentPassword));
+			PianoJsonAddBool (w, "userInitiatedChange", true);
+			PianoJsonAddString (w, "currentUsername", reqData->currentUsername);
+			PianoJsonAddString (w, "currentPassword", reqData->currentPassword);
 
 			if (reqData->explicitContentFilter != PIANO_UNDEFINED) {
-				json_object_object_add (j, "isExplicitContentFilterEnabled",
-						json_object_new_boolean (
-						reqData->explicitContentFilter == PIANO_TRUE));
+				PianoJsonAddBool (w, "isExplicitContentFilterEnabled",
+						reqData->explicitContentFilter == PIANO_TRUE);
 			}
 
 #define changeIfSet(field) \
 	if (reqData->field != NULL) { \
-		json_object_object_add (j, #field, \
-				json_object_new_string (reqData->field)); \
+		PianoJsonAddString (w, #field, reqData->field); \
 	}
 
 			changeIfSet (newUsername);
@@ -545,39 +533,49 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 	/* standard parameter */
 	if (method != NULL) {
-		char *urlencAuthToken;
-
 		assert (ph->user.authToken != NULL);
-
-		urlencAuthToken = PianoEncodeAuthToken (ph->user.authToken);
-		assert (urlencAuthToken != NULL);
+		assert (ph->user.urlParams != NULL);
 
 		snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
-				"method=%s&auth_token=%s&partner_id=%i&user_id=%s", method,
-				urlencAuthToken, ph->partner.id, ph->user.listenerId);
+				"method=%s&%s", method, ph->user.urlParams);
+
+		/* parameters only, auth token and time differ between identical
+		 * requests; no key is no problem */
+		if (PianoRequestIsReadOnly (req->type) && !w->failed) {
+			/* object is still open, that's fine for a key */
+			const char * const params = w->buf;
+			const size_t size = strlen (method) +
+					strlen (ph->user.listenerId) + w->length + 3;
+
+			if ((req->cacheKey = malloc (size)) != NULL) {
+				snprintf (req->cacheKey, size, "%s %s %s", method,
+						ph->user.listenerId, params);
+			}
+		}
 
-		free (urlencAuthToken);
+		PianoJsonAddString (w, "userAuthToken", ph->user.authToken);
+		PianoJsonAddInt (w, "syncTime", timestamp);
+	}
 
-		json_object_object_add (j, "userAuthToken",
-				json_object_new_string (ph->user.authToken));
-		json_object_object_add (j, "syncTime",
-				json_object_new_int64 (timestamp));
+	PianoJsonEndObject (w);
+	if (w->failed) {
+		return PIANO_RET_OUT_OF_MEMORY;
 	}
 
-	/* json to string */
-	jsonSendBuf = json_object_to_json_string (j);
 	if (encrypted) {
-		if ((req->postData = PianoEncryptString (ph->partner.out,
-				jsonSendBuf)) == NULL) {
-			ret = PIANO_RET_OUT_OF_MEMORY;
+		/* straight from the writer's buffer into the hex-encoded body */
+		if ((req->postData = malloc (PianoEncryptHexSize (w->length))) == NULL) {
+			return PIANO_RET_OUT_OF_MEMORY;
 		}
+		PianoEncryptHex (ph->partner.out, w->buf, w->length, req->postData);
 	} else {
-		req->postData = strdup (jsonSendBuf);
+		if ((req->postData = malloc (w->length + 1)) == NULL) {
+			return PIANO_RET_OUT_OF_MEMORY;
+		}
+		memcpy (req->postData, w->buf, w->length + 1);
 	}
 
 cleanup:
-	json_object_put (j);
-
 	return ret;
 }
 
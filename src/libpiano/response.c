@@ -24,6 +24,7 @@ THE SOFTWARE.
 #include "config.h"
 
 #include <json/json.h>
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <time.h>
@@ -33,13 +34,40 @@ THE SOFTWARE.
 #include "piano_private.h"
 #include "crypt.h"
 
-static char *PianoJsonStrdup (json_object *j, const char *key) {
+/*	copy string member of object
+ *	@param arena the copy goes to, NULL to strdup
+ *	@param object
+ *	@param member name
+ *	@return copy or NULL if there is no such member
+ */
+static char *PianoJsonStrdup (PianoArena_t * const arena, json_object *j,
+		const char *key) {
 	assert (j != NULL);
 	assert (key != NULL);
 
 	json_object *v;
 	if (json_object_object_get_ex (j, key, &v)) {
-		return strdup (json_object_get_string (v));
+		const char * const value = json_object_get_string (v);
+		return arena != NULL ? PianoArenaStrdup (arena, value) : strdup (value);
+	} else {
+		return NULL;
+	}
+}
+
+/*	shared copy of string member of object, see PianoIntern
+ *	@param piano handle
+ *	@param object
+ *	@param member name
+ *	@return string or NULL if there is no such member
+ */
+static char *PianoJsonIntern (PianoHandle_t * const ph, json_object *j,
+		const char *key) {
+	assert (j != NULL);
+	assert (key != NULL);
+
+	json_object *v;
+	if (json_object_object_get_ex (j, key, &v)) {
+		return PianoIntern (ph, json_object_get_string (v));
 	} else {
 		return NULL;
 	}
@@ -57,13 +85,29 @@ static bool getBoolDefault (json_object * const j, const char * const key, const
 	}
 }
 
-static void PianoJsonParseStation (json_object *j, PianoStation_t *s) {
-	s->name = PianoJsonStrdup (j, "stationName");
-	s->id = PianoJsonStrdup (j, "stationToken");
+static void PianoJsonParseStation (PianoHandle_t * const ph,
+		PianoArena_t * const arena, json_object *j, PianoStation_t *s) {
+	s->name = PianoJsonStrdup (arena, j, "stationName");
+	/* ids of arena stations are interned */
+	s->id = arena != NULL ? PianoJsonIntern (ph, j, "stationToken") :
+			PianoJsonStrdup (NULL, j, "stationToken");
 	s->isCreator = !getBoolDefault (j, "isShared", !false);
 	s->isQuickMix = getBoolDefault (j, "isQuickMix", false);
 }
 
+/*	list node owned by the arena of the response, which is created on first
+ *	use; strings of the node should go there as well
+ *	@param arena of response, NULL until the first node
+ *	@param size of node
+ *	@return zeroed node or NULL
+ */
+static void *PianoResponseNode (PianoArena_t **arena, const size_t size) {
+	if (*arena == NULL && (*arena = PianoArenaNew ()) == NULL) {
+		return NULL;
+	}
+	return PianoArenaNode (*arena, size);
+}
+
 /*	concat strings
  *	@param destination
  *	@param source string
@@ -88,6 +132,514 @@ static void PianoStrpcat (char * restrict dest, const char * restrict src,
 	*dest = '\0';
 }
 
+/* station id of a quickmix, see PianoResponseStreamStations */
+typedef struct PianoResponseId {
+	struct PianoResponseId *next;
+	char *id;
+} PianoResponseId_t;
+
+/* station list or station info read straight into list nodes while the
+ * response is received, so there is no document of the whole response; the
+ * nodes live in arena, but hold no reference and carry plain copies of
+ * interned strings until PianoResponseStreamCommit */
+struct PianoResponseStream {
+	PianoJsonReader_t reader;
+	PianoArena_t *arena;
+	/* stat is ok */
+	bool ok;
+	/* element being read */
+	PianoStation_t *station;
+	PianoSong_t *song;
+	PianoArtist_t *artist;
+	/* PIANO_REQUEST_GET_STATIONS */
+	PianoListAnchor_t stations;
+	PianoResponseId_t *ids, *mix;
+	/* PIANO_REQUEST_GET_STATION_INFO */
+	PianoListAnchor_t songSeeds, artistSeeds, thumbsUp, thumbsDown;
+};
+
+/* where an event is relative to an array of objects */
+typedef enum {
+	PIANO_STREAM_OUTSIDE = 0,
+	PIANO_STREAM_BEGIN,
+	PIANO_STREAM_END,
+	/* scalar member of one of the objects */
+	PIANO_STREAM_MEMBER,
+} PianoResponseStreamAt_t;
+
+static const char * const stationsPath[] = {"result", "stations", NULL};
+static const char * const songSeedsPath[] = {"result", "music", "songs",
+		NULL};
+static const char * const artistSeedsPath[] = {"result", "music", "artists",
+		NULL};
+static const char * const thumbsUpPath[] = {"result", "feedback", "thumbsUp",
+		NULL};
+static const char * const thumbsDownPath[] = {"result", "feedback",
+		"thumbsDown", NULL};
+
+static void PianoResponseStreamDestroy (struct PianoResponseStream * const s) {
+	PianoJsonReaderDestroy (&s->reader);
+	PianoArenaRelease (s->arena);
+	free (s);
+}
+
+/*	locate event
+ *	@param stream
+ *	@param event
+ *	@param path of the array, see PianoJsonReaderIn
+ *	@param length of path
+ */
+static PianoResponseStreamAt_t PianoResponseStreamWhere (
+		const struct PianoResponseStream * const s,
+		const PianoJsonEvent_t event, const char * const * const path,
+		const size_t depth) {
+	const PianoJsonReader_t * const r = &s->reader;
+
+	if (!PianoJsonReaderIn (r, path, depth)) {
+		return PIANO_STREAM_OUTSIDE;
+	}
+	if (r->depth == depth) {
+		return event == PIANO_JSON_BEGIN_OBJECT ? PIANO_STREAM_BEGIN :
+				event == PIANO_JSON_END_OBJECT ? PIANO_STREAM_END :
+				PIANO_STREAM_OUTSIDE;
+	}
+	if (r->depth == depth + 1 && !r->frame[depth].array &&
+			event >= PIANO_JSON_STRING) {
+		return PIANO_STREAM_MEMBER;
+	}
+	return PIANO_STREAM_OUTSIDE;
+}
+
+/*	copy of scalar, like json_object_get_string
+ *	@param stream
+ *	@param scalar event
+ *	@param destination, NULL for null
+ *	@return false if out of memory
+ */
+static bool PianoResponseStreamString (struct PianoResponseStream * const s,
+		const PianoJsonEvent_t event, char ** const dest) {
+	const char *value;
+
+	switch (event) {
+		case PIANO_JSON_NULL:
+			*dest = NULL;
+			return true;
+
+		case PIANO_JSON_TRUE:
+			value = "true";
+			break;
+
+		case PIANO_JSON_FALSE:
+			value = "false";
+			break;
+
+		default:
+			value = s->reader.text;
+			break;
+	}
+	return (*dest = PianoArenaStrdup (s->arena, value)) != NULL;
+}
+
+/*	scalar as bool, like json_object_get_boolean
+ */
+static bool PianoResponseStreamBool (const struct PianoResponseStream * const s,
+		const PianoJsonEvent_t event) {
+	switch (event) {
+		case PIANO_JSON_TRUE:
+			return true;
+
+		case PIANO_JSON_NUMBER:
+			return strtod (s->reader.text, NULL) != 0;
+
+		case PIANO_JSON_STRING:
+			return s->reader.length > 0;
+
+		default:
+			return false;
+	}
+}
+
+/*	scalar as int, like json_object_get_int
+ */
+static int PianoResponseStreamInt (const struct PianoResponseStream * const s,
+		const PianoJsonEvent_t event) {
+	switch (event) {
+		case PIANO_JSON_TRUE:
+			return 1;
+
+		case PIANO_JSON_NUMBER:
+		case PIANO_JSON_STRING:
+			return (int) strtol (s->reader.text, NULL, 10);
+
+		default:
+			return 0;
+	}
+}
+
+/*	result.stations of PIANO_REQUEST_GET_STATIONS
+ *	@return false if out of memory
+ */
+static bool PianoResponseStreamStations (struct PianoResponseStream * const s,
+		const PianoJsonEvent_t event) {
+	const PianoJsonReader_t * const r = &s->reader;
+	PianoStation_t *station = s->station;
+
+	switch (PianoResponseStreamWhere (s, event, stationsPath, 3)) {
+		case PIANO_STREAM_BEGIN:
+			if ((station = PianoArenaAlloc (s->arena,
+					sizeof (*station))) == NULL) {
+				return false;
+			}
+			station->arena = s->arena;
+			PianoListAnchorAppendP (&s->stations, station);
+			s->station = station;
+			s->ids = NULL;
+			return true;
+
+		case PIANO_STREAM_END:
+			if (station->isQuickMix) {
+				/* fix flags on other stations later */
+				s->mix = s->ids;
+			}
+			s->station = NULL;
+			return true;
+
+		case PIANO_STREAM_MEMBER: {
+			const char * const key = r->frame[3].key;
+
+			if (strcmp (key, "stationName") == 0) {
+				return PianoResponseStreamString (s, event, &station->name);
+			} else if (strcmp (key, "stationToken") == 0) {
+				return PianoResponseStreamString (s, event, &station->id);
+			} else if (strcmp (key, "isShared") == 0) {
+				station->isCreator = !PianoResponseStreamBool (s, event);
+			} else if (strcmp (key, "isQuickMix") == 0) {
+				station->isQuickMix = PianoResponseStreamBool (s, event);
+			}
+			return true;
+		}
+
+		case PIANO_STREAM_OUTSIDE:
+			break;
+	}
+
+	/* items of quickMixStationIds */
+	if (station != NULL && r->depth == 5 && !r->frame[3].array &&
+			strcmp (r->frame[3].key, "quickMixStationIds") == 0 &&
+			r->frame[4].array && event >= PIANO_JSON_STRING &&
+			event != PIANO_JSON_NULL) {
+		PianoResponseId_t * const id = PianoArenaAlloc (s->arena,
+				sizeof (*id));
+		if (id == NULL || !PianoResponseStreamString (s, event, &id->id)) {
+			return false;
+		}
+		id->next = s->ids;
+		s->ids = id;
+	}
+	return true;
+}
+
+/*	feedback song in result.feedback.thumbsUp or thumbsDown
+ *	@return false if out of memory
+ */
+static bool PianoResponseStreamFeedback (struct PianoResponseStream * const s,
+		const PianoJsonEvent_t event, const char * const * const path,
+		PianoListAnchor_t * const list) {
+	PianoSong_t *song = s->song;
+
+	switch (PianoResponseStreamWhere (s, event, path, 4)) {
+		case PIANO_STREAM_BEGIN:
+			if ((song = PianoArenaAlloc (s->arena, sizeof (*song))) == NULL) {
+				return false;
+			}
+			song->arena = s->arena;
+			song->rating = PIANO_RATE_BAN;
+			PianoListAnchorAppendP (list, song);
+			s->song = song;
+			break;
+
+		case PIANO_STREAM_END:
+			s->song = NULL;
+			break;
+
+		case PIANO_STREAM_MEMBER: {
+			const char * const key = s->reader.frame[4].key;
+
+			if (strcmp (key, "songName") == 0) {
+				return PianoResponseStreamString (s, event, &song->title);
+			} else if (strcmp (key, "artistName") == 0) {
+				return PianoResponseStreamString (s, event, &song->artist);
+			} else if (strcmp (key, "feedbackId") == 0) {
+				return PianoResponseStreamString (s, event,
+						&song->feedbackId);
+			} else if (strcmp (key, "isPositive") == 0) {
+				song->rating = PianoResponseStreamBool (s, event) ?
+						PIANO_RATE_LOVE : PIANO_RATE_BAN;
+			} else if (strcmp (key, "trackLength") == 0) {
+				song->length = PianoResponseStreamInt (s, event);
+			}
+			break;
+		}
+
+		case PIANO_STREAM_OUTSIDE:
+			break;
+	}
+	return true;
+}
+
+/*	seeds and feedback of PIANO_REQUEST_GET_STATION_INFO
+ *	@return false if out of memory
+ */
+static bool PianoResponseStreamStationInfo (
+		struct PianoResponseStream * const s, const PianoJsonEvent_t event) {
+	const char * const key = s->reader.depth > 4 ? s->reader.frame[4].key :
+			NULL;
+	PianoSong_t *song = s->song;
+	PianoArtist_t *artist = s->artist;
+
+	switch (PianoResponseStreamWhere (s, event, songSeedsPath, 4)) {
+		case PIANO_STREAM_BEGIN:
+			if ((song = PianoArenaAlloc (s->arena, sizeof (*song))) == NULL) {
+				return false;
+			}
+			song->arena = s->arena;
+			PianoListAnchorAppendP (&s->songSeeds, song);
+			s->song = song;
+			return true;
+
+		case PIANO_STREAM_END:
+			s->song = NULL;
+			return true;
+
+		case PIANO_STREAM_MEMBER:
+			if (strcmp (key, "songName") == 0) {
+				return PianoResponseStreamString (s, event, &song->title);
+			} else if (strcmp (key, "artistName") == 0) {
+				return PianoResponseStreamString (s, event, &song->artist);
+			} else if (strcmp (key, "seedId") == 0) {
+				return PianoResponseStreamString (s, event, &song->seedId);
+			}
+			return true;
+
+		case PIANO_STREAM_OUTSIDE:
+			break;
+	}
+
+	switch (PianoResponseStreamWhere (s, event, artistSeedsPath, 4)) {
+		case PIANO_STREAM_BEGIN:
+			if ((artist = PianoArenaAlloc (s->arena,
+					sizeof (*artist))) == NULL) {
+				return false;
+			}
+			artist->arena = s->arena;
+			PianoListAnchorAppendP (&s->artistSeeds, artist);
+			s->artist = artist;
+			return true;
+
+		case PIANO_STREAM_END:
+			s->artist = NULL;
+			return true;
+
+		case PIANO_STREAM_MEMBER:
+			if (strcmp (key, "artistName") == 0) {
+				return PianoResponseStreamString (s, event, &artist->name);
+			} else if (strcmp (key, "seedId") == 0) {
+				return PianoResponseStreamString (s, event, &artist->seedId);
+			}
+			return true;
+
+		case PIANO_STREAM_OUTSIDE:
+			break;
+	}
+
+	return PianoResponseStreamFeedback (s, event, thumbsUpPath,
+			&s->thumbsUp) && PianoResponseStreamFeedback (s, event,
+			thumbsDownPath, &s->thumbsDown);
+}
+
+/*	read chunk into list nodes, see struct PianoResponseStream
+ */
+static void PianoResponseStreamFeed (PianoRequest_t * const req,
+		const char *data, size_t size) {
+	struct PianoResponseStream *s = req->responseStream;
+	PianoJsonEvent_t event;
+
+	if (s == NULL) {
+		if ((s = calloc (1, sizeof (*s))) == NULL) {
+			req->responseParseFailed = true;
+			return;
+		}
+		if ((s->arena = PianoArenaNew ()) == NULL) {
+			free (s);
+			req->responseParseFailed = true;
+			return;
+		}
+		PianoJsonReaderInit (&s->reader);
+		req->responseStream = s;
+	}
+
+	while ((event = PianoJsonRead (&s->reader, &data, &size)) !=
+			PIANO_JSON_MORE) {
+		const PianoJsonReader_t * const r = &s->reader;
+		bool ok = false;
+
+		if (event != PIANO_JSON_ERROR) {
+			if (r->depth == 1 && !r->frame[0].array &&
+					event >= PIANO_JSON_STRING &&
+					strcmp (r->frame[0].key, "stat") == 0) {
+				s->ok = event == PIANO_JSON_STRING &&
+						strcmp (r->text, "ok") == 0;
+			}
+			ok = req->type == PIANO_REQUEST_GET_STATIONS ?
+					PianoResponseStreamStations (s, event) :
+					PianoResponseStreamStationInfo (s, event);
+		}
+
+		if (!ok) {
+			/* PianoResponse parses responseData instead */
+			PianoResponseStreamDestroy (s);
+			req->responseStream = NULL;
+			req->responseParseFailed = true;
+			return;
+		}
+	}
+}
+
+/*	take first node off list read by PianoResponseStreamFeed; it becomes a
+ *	node of its own, holding a reference to the arena
+ *	@param stream
+ *	@param list
+ *	@return node or NULL if list is empty
+ */
+static void *PianoResponseStreamTake (struct PianoResponseStream * const s,
+		PianoListAnchor_t * const list) {
+	PianoListHead_t * const e = list->first;
+
+	if (e != NULL) {
+		list->first = e->next;
+		e->next = NULL;
+		PianoArenaRetain (s->arena);
+	}
+	return e;
+}
+
+/*	add nodes read by PianoResponseStreamFeed to handle or request, must be
+ *	called from the thread that owns the handle
+ */
+static void PianoResponseStreamCommit (PianoHandle_t * const ph,
+		PianoRequest_t * const req, struct PianoResponseStream * const s) {
+	if (req->type == PIANO_REQUEST_GET_STATIONS) {
+		PianoListAnchor_t stationList;
+		PianoStation_t *station;
+
+		PianoListAnchorInitP (&stationList, ph->stations);
+		while ((station = PianoResponseStreamTake (s, &s->stations)) != NULL) {
+			station->id = PianoIntern (ph, station->id);
+			ph->stations = PianoListAnchorAppendP (&stationList, station);
+			PianoIndexAdd (ph, station);
+		}
+
+		/* fix quickmix flags, one index lookup per id */
+		for (const PianoResponseId_t *id = s->mix; id != NULL; id = id->next) {
+			PianoStation_t * const mixStation = PianoGetStationById (ph,
+					id->id);
+			if (mixStation != NULL) {
+				mixStation->useQuickMix = true;
+			}
+		}
+	} else {
+		PianoRequestDataGetStationInfo_t * const reqData = req->data;
+		PianoStationInfo_t * const info = &reqData->info;
+		PianoListAnchor_t list;
+		PianoSong_t *song;
+		PianoArtist_t *artist;
+
+		PianoListAnchorInitP (&list, info->songSeeds);
+		while ((song = PianoResponseStreamTake (s, &s->songSeeds)) != NULL) {
+			song->artist = PianoIntern (ph, song->artist);
+			info->songSeeds = PianoListAnchorAppendP (&list, song);
+		}
+
+		PianoListAnchorInitP (&list, info->artistSeeds);
+		while ((artist = PianoResponseStreamTake (s, &s->artistSeeds)) !=
+				NULL) {
+			artist->name = PianoIntern (ph, artist->name);
+			info->artistSeeds = PianoListAnchorAppendP (&list, artist);
+		}
+
+		PianoListAnchorInitP (&list, info->feedback);
+		while ((song = PianoResponseStreamTake (s, &s->thumbsUp)) != NULL ||
+				(song = PianoResponseStreamTake (s, &s->thumbsDown)) != NULL) {
+			song->artist = PianoIntern (ph, song->artist);
+			info->feedback = PianoListAnchorAppendP (&list, song);
+		}
+	}
+}
+
+/*	forget what PianoResponseFeed parsed so far, e.g. because the response
+ *	is received again
+ *	@param request
+ */
+void PianoResponseReset (PianoRequest_t *req) {
+	assert (req != NULL);
+
+	if (req->responseParser != NULL) {
+		json_tokener_free (req->responseParser);
+		req->responseParser = NULL;
+	}
+	if (req->responseJson != NULL) {
+		json_object_put (req->responseJson);
+		req->responseJson = NULL;
+	}
+	if (req->responseStream != NULL) {
+		PianoResponseStreamDestroy (req->responseStream);
+		req->responseStream = NULL;
+	}
+	req->responseParseFailed = false;
+}
+
+/*	parse response body chunk by chunk while it is being received, so
+ *	PianoResponse does not have to start from scratch once it is complete;
+ *	station lists and station info go straight into list nodes, other
+ *	responses into a json-c document; on malformed input PianoResponse
+ *	parses responseData as usual
+ *	@param request
+ *	@param next chunk of response body
+ *	@param size of chunk
+ */
+void PianoResponseFeed (PianoRequest_t *req, const char *data, size_t size) {
+	assert (req != NULL);
+
+	/* anything after the document is none of our business */
+	if (req->responseJson != NULL || req->responseParseFailed || size == 0) {
+		return;
+	}
+
+	if (req->type == PIANO_REQUEST_GET_STATIONS ||
+			req->type == PIANO_REQUEST_GET_STATION_INFO) {
+		PianoResponseStreamFeed (req, data, size);
+		return;
+	}
+
+	if (req->responseParser == NULL &&
+			(req->responseParser = json_tokener_new ()) == NULL) {
+		req->responseParseFailed = true;
+		return;
+	}
+
+	req->responseJson = json_tokener_parse_ex (req->responseParser, data,
+			(int) size);
+	if (req->responseJson == NULL && json_tokener_get_error (
+			req->responseParser) == json_tokener_continue) {
+		return;
+	}
+
+	/* done, one way or the other */
+	req->responseParseFailed = req->responseJson == NULL;
+	json_tokener_free (req->responseParser);
+	req->responseParser = NULL;
+}
+
 /*	parse xml response and update data structures/return new data structure
  *	@param piano handle
  *	@param initialized request (expects responseData to be a NUL-terminated
@@ -95,11 +647,42 @@ static void PianoStrpcat (char * restrict dest, const char * restrict src,
  */
 PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 	PianoReturn_t ret = PIANO_RET_OK;
+	json_object *j;
+	/* nodes and strings of result lists, each node holds a reference */
+	PianoArena_t *arena = NULL;
 
 	assert (ph != NULL);
 	assert (req != NULL);
 
-	json_object * const j = json_tokener_parse (req->responseData);
+	/* lists read by PianoResponseFeed; anything but a complete, successful
+	 * response, like an error, is parsed from responseData below */
+	struct PianoResponseStream * const stream = req->responseStream;
+	req->responseStream = NULL;
+	if (stream != NULL) {
+		const bool complete = stream->reader.done && stream->ok;
+		if (complete) {
+			PianoResponseStreamCommit (ph, req, stream);
+		}
+		PianoResponseStreamDestroy (stream);
+		if (complete) {
+			return PIANO_RET_OK;
+		}
+	}
+
+	/* use document parsed by PianoResponseFeed if it is complete */
+	j = req->responseJson;
+	req->responseJson = NULL;
+	if (j == NULL) {
+		/* size is known, spare json-c the strlen */
+		json_tokener * const tok = json_tokener_new ();
+		if (tok == NULL) {
+			return PIANO_RET_OUT_OF_MEMORY;
+		}
+		j = json_tokener_parse_ex (tok, req->responseData,
+				req->responseDataSize > 0 ? (int) req->responseDataSize :
+				(int) strlen (req->responseData));
+		json_tokener_free (tok);
+	}
 
 	json_object *status;
 	if (!json_object_object_get_ex (j, "stat", &status)) {
@@ -169,9 +752,14 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						ret = PIANO_RET_CONTINUE_REQUEST;
 					}
 					free (decryptedTimestamp);
-					/* get auth token */
-					ph->partner.authToken = PianoJsonStrdup (result,
+					/* get auth token, previous one is left over when
+					 * reauthenticating */
+					free (ph->partner.authToken);
+					free (ph->partner.urlAuthToken);
+					ph->partner.authToken = PianoJsonStrdup (NULL, result,
 							"partnerAuthToken");
+					ph->partner.urlAuthToken = ph->partner.authToken != NULL ?
+							PianoUrlEncode (ph->partner.authToken) : NULL;
 					json_object *partnerId;
 					if (!json_object_object_get_ex (result, "partnerId", &partnerId)) {
 						ret = PIANO_RET_INVALID_RESPONSE;
@@ -188,9 +776,32 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 					if (ph->user.listenerId != NULL) {
 						PianoDestroyUserInfo (&ph->user);
 					}
-					ph->user.listenerId = PianoJsonStrdup (result, "userId");
-					ph->user.authToken = PianoJsonStrdup (result,
+					ph->user.listenerId = PianoJsonStrdup (NULL, result, "userId");
+					ph->user.authToken = PianoJsonStrdup (NULL, result,
 							"userAuthToken");
+					ph->user.urlParams = NULL;
+					if (ph->user.listenerId != NULL &&
+							ph->user.authToken != NULL) {
+						/* same for every request until the next login */
+						static const char format[] =
+								"auth_token=%s&partner_id=%u&user_id=%s";
+						char * const urlAuthToken =
+								PianoUrlEncode (ph->user.authToken);
+						/* partner id has ten digits at most */
+						const size_t size = urlAuthToken == NULL ? 0 :
+								sizeof (format) + strlen (urlAuthToken) + 10 +
+								strlen (ph->user.listenerId);
+
+						if (urlAuthToken == NULL ||
+								(ph->user.urlParams = malloc (size)) == NULL) {
+							ret = PIANO_RET_OUT_OF_MEMORY;
+						} else {
+							snprintf (ph->user.urlParams, size, format,
+									urlAuthToken, ph->partner.id,
+									ph->user.listenerId);
+						}
+						free (urlAuthToken);
+					}
 					break;
 			}
 			break;
@@ -206,15 +817,21 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				break;
 			}
 
+			PianoListAnchor_t stationList;
+			PianoListAnchorInitP (&stationList, ph->stations);
+
 			for (int i = 0; i < json_object_array_length (stations); i++) {
 				PianoStation_t *tmpStation;
 				json_object *s = json_object_array_get_idx (stations, i);
 
-				if ((tmpStation = calloc (1, sizeof (*tmpStation))) == NULL) {
-					return PIANO_RET_OUT_OF_MEMORY;
+				if ((tmpStation = PianoResponseNode (&arena,
+						sizeof (*tmpStation))) == NULL) {
+					ret = PIANO_RET_OUT_OF_MEMORY;
+					goto cleanup;
 				}
+				tmpStation->arena = arena;
 
-				PianoJsonParseStation (s, tmpStation);
+				PianoJsonParseStation (ph, arena, s, tmpStation);
 
 				if (tmpStation->isQuickMix) {
 					/* fix flags on other stations later */
@@ -222,19 +839,18 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				}
 
 				/* start new linked list or append */
-				ph->stations = PianoListAppendP (ph->stations, tmpStation);
+				ph->stations = PianoListAnchorAppendP (&stationList, tmpStation);
+				PianoIndexAdd (ph, tmpStation);
 			}
 
-			/* fix quickmix flags */
+			/* fix quickmix flags, one index lookup per id */
 			if (mix != NULL) {
-				PianoStation_t *curStation = ph->stations;
-				PianoListForeachP (curStation) {
-					for (int i = 0; i < json_object_array_length (mix); i++) {
-						json_object *id = json_object_array_get_idx (mix, i);
-						if (strcmp (json_object_get_string (id),
-								curStation->id) == 0) {
-							curStation->useQuickMix = true;
-						}
+				for (int i = 0; i < json_object_array_length (mix); i++) {
+					json_object *id = json_object_array_get_idx (mix, i);
+					PianoStation_t * const mixStation = PianoGetStationById (ph,
+							json_object_get_string (id));
+					if (mixStation != NULL) {
+						mixStation->useQuickMix = true;
 					}
 				}
 			}
@@ -245,6 +861,9 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			/* get playlist, usually four songs */
 			PianoRequestDataGetPlaylist_t *reqData = req->data;
 			PianoSong_t *playlist = NULL;
+			PianoListAnchor_t songList;
+
+			PianoListAnchorInit (&songList, NULL);
 
 			assert (req->responseData != NULL);
 			assert (reqData != NULL);
@@ -260,15 +879,17 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				json_object *s = json_object_array_get_idx (items, i);
 				PianoSong_t *song;
 
-				if ((song = calloc (1, sizeof (*song))) == NULL) {
-					return PIANO_RET_OUT_OF_MEMORY;
-				}
-
 				if (!json_object_object_get_ex (s, "artistName", NULL)) {
-					free (song);
 					continue;
 				}
 
+				if ((song = PianoResponseNode (&arena, sizeof (*song))) == NULL) {
+					ret = PIANO_RET_OUT_OF_MEMORY;
+					PianoDestroyPlaylist (playlist);
+					goto cleanup;
+				}
+				song->arena = arena;
+
 				/* get audio url based on selected quality */
 				static const char *qualityMap[] = {"", "lowQuality", "mediumQuality",
 						"highQuality"};
@@ -290,24 +911,24 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 								break;
 							}
 						}
-						song->audioUrl = PianoJsonStrdup (qmap, "audioUrl");
+						song->audioUrl = PianoJsonStrdup (arena, qmap, "audioUrl");
 					} else {
 						/* requested quality is not available */
 						ret = PIANO_RET_QUALITY_UNAVAILABLE;
-						free (song);
+						PianoDestroyPlaylist (song);
 						PianoDestroyPlaylist (playlist);
 						goto cleanup;
 					}
 				}
 
 				json_object *v;
-				song->artist = PianoJsonStrdup (s, "artistName");
-				song->album = PianoJsonStrdup (s, "albumName");
-				song->title = PianoJsonStrdup (s, "songName");
-				song->trackToken = PianoJsonStrdup (s, "trackToken");
-				song->stationId = PianoJsonStrdup (s, "stationId");
-				song->coverArt = PianoJsonStrdup (s, "albumArtUrl");
-				song->detailUrl = PianoJsonStrdup (s, "songDetailUrl");
+				song->artist = PianoJsonIntern (ph, s, "artistName");
+				song->album = PianoJsonIntern (ph, s, "albumName");
+				song->title = PianoJsonStrdup (arena, s, "songName");
+				song->trackToken = PianoJsonStrdup (arena, s, "trackToken");
+				song->stationId = PianoJsonIntern (ph, s, "stationId");
+				song->coverArt = PianoJsonStrdup (arena, s, "albumArtUrl");
+				song->detailUrl = PianoJsonStrdup (arena, s, "songDetailUrl");
 				song->fileGain = json_object_object_get_ex (s, "trackGain", &v) ?
 						(float)json_object_get_double (v) : 0.0f;
 				song->length = json_object_object_get_ex (s, "trackLength", &v) ?
@@ -319,7 +940,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						break;
 				}
 
-				playlist = PianoListAppendP (playlist, song);
+				playlist = PianoListAnchorAppendP (&songList, song);
 			}
 
 			reqData->retPlaylist = playlist;
@@ -346,8 +967,15 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			assert (reqData->station != NULL);
 			assert (reqData->newName != NULL);
 
-			free (reqData->station->name);
-			reqData->station->name = strdup (reqData->newName);
+			PianoStation_t * const station = reqData->station;
+			if (station->arena != NULL) {
+				/* old name stays in the arena until the station is gone */
+				station->name = PianoArenaStrdup (station->arena,
+						reqData->newName);
+			} else {
+				free (station->name);
+				station->name = strdup (reqData->newName);
+			}
 			break;
 		}
 
@@ -357,9 +985,9 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			assert (station != NULL);
 
+			PianoIndexRemove (ph, station);
 			ph->stations = PianoListDeleteP (ph->stations, station);
 			PianoDestroyStation (station);
-			free (station);
 			break;
 		}
 
@@ -377,39 +1005,49 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			/* get artists */
 			json_object *artists;
 			if (json_object_object_get_ex (result, "artists", &artists)) {
+				PianoListAnchor_t artistList;
+				PianoListAnchorInit (&artistList, NULL);
 				for (int i = 0; i < json_object_array_length (artists); i++) {
 					json_object *a = json_object_array_get_idx (artists, i);
 					PianoArtist_t *artist;
 
-					if ((artist = calloc (1, sizeof (*artist))) == NULL) {
-						return PIANO_RET_OUT_OF_MEMORY;
+					if ((artist = PianoResponseNode (&arena,
+							sizeof (*artist))) == NULL) {
+						ret = PIANO_RET_OUT_OF_MEMORY;
+						goto cleanup;
 					}
+					artist->arena = arena;
 
-					artist->name = PianoJsonStrdup (a, "artistName");
-					artist->musicId = PianoJsonStrdup (a, "musicToken");
+					artist->name = PianoJsonIntern (ph, a, "artistName");
+					artist->musicId = PianoJsonStrdup (arena, a, "musicToken");
 
 					searchResult->artists =
-							PianoListAppendP (searchResult->artists, artist);
+							PianoListAnchorAppendP (&artistList, artist);
 				}
 			}
 
 			/* get songs */
 			json_object *songs;
 			if (json_object_object_get_ex (result, "songs", &songs)) {
+				PianoListAnchor_t songList;
+				PianoListAnchorInit (&songList, NULL);
 				for (int i = 0; i < json_object_array_length (songs); i++) {
 					json_object *s = json_object_array_get_idx (songs, i);
 					PianoSong_t *song;
 
-					if ((song = calloc (1, sizeof (*song))) == NULL) {
-						return PIANO_RET_OUT_OF_MEMORY;
+					if ((song = PianoResponseNode (&arena,
+							sizeof (*song))) == NULL) {
+						ret = PIANO_RET_OUT_OF_MEMORY;
+						goto cleanup;
 					}
+					song->arena = arena;
 
-					song->title = PianoJsonStrdup (s, "songName");
-					song->artist = PianoJsonStrdup (s, "artistName");
-					song->musicId = PianoJsonStrdup (s, "musicToken");
+					song->title = PianoJsonStrdup (arena, s, "songName");
+					song->artist = PianoJsonIntern (ph, s, "artistName");
+					song->musicId = PianoJsonStrdup (arena, s, "musicToken");
 
 					searchResult->songs =
-							PianoListAppendP (searchResult->songs, song);
+							PianoListAnchorAppendP (&songList, song);
 				}
 			}
 			break;
@@ -423,16 +1061,16 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				return PIANO_RET_OUT_OF_MEMORY;
 			}
 
-			PianoJsonParseStation (result, tmpStation);
+			PianoJsonParseStation (ph, NULL, result, tmpStation);
 
-			PianoStation_t *search = PianoFindStationById (ph->stations,
-					tmpStation->id);
+			PianoStation_t *search = PianoGetStationById (ph, tmpStation->id);
 			if (search != NULL) {
+				PianoIndexRemove (ph, search);
 				ph->stations = PianoListDeleteP (ph->stations, search);
 				PianoDestroyStation (search);
-				free (search);
 			}
 			ph->stations = PianoListAppendP (ph->stations, tmpStation);
+			PianoIndexAdd (ph, tmpStation);
 			break;
 		}
 
@@ -456,6 +1094,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			/* get genre stations */
 			json_object *categories;
 			if (json_object_object_get_ex (result, "categories", &categories)) {
+				PianoListAnchor_t categoryList;
+				PianoListAnchorInitP (&categoryList, ph->genreStations);
 				for (int i = 0; i < json_object_array_length (categories); i++) {
 					json_object *c = json_object_array_get_idx (categories, i);
 					PianoGenreCategory_t *tmpGenreCategory;
@@ -465,12 +1105,14 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						return PIANO_RET_OUT_OF_MEMORY;
 					}
 
-					tmpGenreCategory->name = PianoJsonStrdup (c,
+					tmpGenreCategory->name = PianoJsonStrdup (NULL, c,
 							"categoryName");
 
 					/* get genre subnodes */
 					json_object *stations;
 					if (json_object_object_get_ex (c, "stations", &stations)) {
+						PianoListAnchor_t genreList;
+						PianoListAnchorInit (&genreList, NULL);
 						for (int k = 0;
 								k < json_object_array_length (stations); k++) {
 							json_object *s =
@@ -483,18 +1125,17 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 							}
 
 							/* get genre attributes */
-							tmpGenre->name = PianoJsonStrdup (s,
+							tmpGenre->name = PianoJsonStrdup (NULL, s,
 									"stationName");
-							tmpGenre->musicId = PianoJsonStrdup (s,
+							tmpGenre->musicId = PianoJsonStrdup (NULL, s,
 									"stationToken");
 
 							tmpGenreCategory->genres =
-									PianoListAppendP (tmpGenreCategory->genres,
-									tmpGenre);
+									PianoListAnchorAppendP (&genreList, tmpGenre);
 						}
 					}
 
-					ph->genreStations = PianoListAppendP (ph->genreStations,
+					ph->genreStations = PianoListAnchorAppendP (&categoryList,
 							tmpGenreCategory);
 				}
 			}
@@ -553,7 +1194,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			settings->explicitContentFilter = getBoolDefault (result,
 					"isExplicitContentFilterEnabled", false);
-			settings->username = PianoJsonStrdup (result, "username");
+			settings->username = PianoJsonStrdup (NULL, result, "username");
 			break;
 		}
 
@@ -573,20 +1214,24 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				/* songs */
 				json_object *songs;
 				if (json_object_object_get_ex (music, "songs", &songs)) {
+					PianoListAnchor_t seedList;
+					PianoListAnchorInitP (&seedList, info->songSeeds);
 					for (int i = 0; i < json_object_array_length (songs); i++) {
 						json_object *s = json_object_array_get_idx (songs, i);
 						PianoSong_t *seedSong;
 
-						seedSong = calloc (1, sizeof (*seedSong));
+						seedSong = PianoResponseNode (&arena, sizeof (*seedSong));
 						if (seedSong == NULL) {
-							return PIANO_RET_OUT_OF_MEMORY;
+							ret = PIANO_RET_OUT_OF_MEMORY;
+							goto cleanup;
 						}
+						seedSong->arena = arena;
 
-						seedSong->title = PianoJsonStrdup (s, "songName");
-						seedSong->artist = PianoJsonStrdup (s, "artistName");
-						seedSong->seedId = PianoJsonStrdup (s, "seedId");
+						seedSong->title = PianoJsonStrdup (arena, s, "songName");
+						seedSong->artist = PianoJsonIntern (ph, s, "artistName");
+						seedSong->seedId = PianoJsonStrdup (arena, s, "seedId");
 
-						info->songSeeds = PianoListAppendP (info->songSeeds,
+						info->songSeeds = PianoListAnchorAppendP (&seedList,
 								seedSong);
 					}
 				}
@@ -594,20 +1239,25 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				/* artists */
 				json_object *artists;
 				if (json_object_object_get_ex (music, "artists", &artists)) {
+					PianoListAnchor_t seedList;
+					PianoListAnchorInitP (&seedList, info->artistSeeds);
 					for (int i = 0; i < json_object_array_length (artists); i++) {
 						json_object *a = json_object_array_get_idx (artists, i);
 						PianoArtist_t *seedArtist;
 
-						seedArtist = calloc (1, sizeof (*seedArtist));
+						seedArtist = PianoResponseNode (&arena,
+								sizeof (*seedArtist));
 						if (seedArtist == NULL) {
-							return PIANO_RET_OUT_OF_MEMORY;
+							ret = PIANO_RET_OUT_OF_MEMORY;
+							goto cleanup;
 						}
+						seedArtist->arena = arena;
 
-						seedArtist->name = PianoJsonStrdup (a, "artistName");
-						seedArtist->seedId = PianoJsonStrdup (a, "seedId");
+						seedArtist->name = PianoJsonIntern (ph, a, "artistName");
+						seedArtist->seedId = PianoJsonStrdup (arena, a, "seedId");
 
 						info->artistSeeds =
-								PianoListAppendP (info->artistSeeds, seedArtist);
+								PianoListAnchorAppendP (&seedList, seedArtist);
 					}
 				}
 			}
@@ -616,6 +1266,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 			json_object *feedback;
 			if (json_object_object_get_ex (result, "feedback", &feedback)) {
 				static const char * const keys[] = {"thumbsUp", "thumbsDown"};
+				PianoListAnchor_t feedbackList;
+				PianoListAnchorInitP (&feedbackList, info->feedback);
 				for (size_t i = 0; i < sizeof (keys)/sizeof (*keys); i++) {
 					json_object *val;
 					if (!json_object_object_get_ex (feedback, keys[i], &val)) {
@@ -626,15 +1278,19 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						json_object *s = json_object_array_get_idx (val, i);
 						PianoSong_t *feedbackSong;
 
-						feedbackSong = calloc (1, sizeof (*feedbackSong));
+						feedbackSong = PianoResponseNode (&arena,
+								sizeof (*feedbackSong));
 						if (feedbackSong == NULL) {
-							return PIANO_RET_OUT_OF_MEMORY;
+							ret = PIANO_RET_OUT_OF_MEMORY;
+							goto cleanup;
 						}
+						feedbackSong->arena = arena;
 
-						feedbackSong->title = PianoJsonStrdup (s, "songName");
-						feedbackSong->artist = PianoJsonStrdup (s,
+						feedbackSong->title = PianoJsonStrdup (arena, s,
+								"songName");
+						feedbackSong->artist = PianoJsonIntern (ph, s,
 								"artistName");
-						feedbackSong->feedbackId = PianoJsonStrdup (s,
+						feedbackSong->feedbackId = PianoJsonStrdup (arena, s,
 								"feedbackId");
 						feedbackSong->rating = getBoolDefault (s, "isPositive",
 								false) ?  PIANO_RATE_LOVE : PIANO_RATE_BAN;
@@ -644,7 +1300,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 								json_object_object_get_ex (s, "trackLength", &v) ?
 								json_object_get_int (v) : 0;
 
-						info->feedback = PianoListAppendP (info->feedback,
+						info->feedback = PianoListAnchorAppendP (&feedbackList,
 								feedbackSong);
 					}
 				}
@@ -665,6 +1321,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			json_object *availableModes;
 			if (json_object_object_get_ex (result, "availableModes", &availableModes)) {
+				PianoListAnchor_t modeList;
+				PianoListAnchorInitP (&modeList, reqData->retModes);
 				for (int i = 0; i < json_object_array_length (availableModes); i++) {
 					json_object *val = json_object_array_get_idx (availableModes, i);
 
@@ -678,8 +1336,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 					json_object *modeId;
 					if (json_object_object_get_ex (val, "modeId", &modeId)) {
 						mode->id = json_object_get_int (modeId);
-						mode->name = PianoJsonStrdup (val, "modeName");
-						mode->description = PianoJsonStrdup (val, "modeDescription");
+						mode->name = PianoJsonStrdup (NULL, val, "modeName");
+						mode->description = PianoJsonStrdup (NULL, val, "modeDescription");
 						mode->isAlgorithmic = getBoolDefault (val, "isAlgorithmicMode",
 								false);
 						mode->isTakeover = getBoolDefault (val, "isTakeoverMode",
@@ -687,8 +1345,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 						mode->active = active == mode->id;
 					}
 
-					reqData->retModes = PianoListAppendP (reqData->retModes,
-							mode);
+					reqData->retModes = PianoListAnchorAppendP (&modeList, mode);
 				}
 			}
 			break;
@@ -714,6 +1371,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 	}
 
 cleanup:
+	PianoArenaRelease (arena);
 	json_object_put (j);
 
 	return ret;
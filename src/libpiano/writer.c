@@ -0,0 +1,210 @@
+/*
+Copyright (c) 2013
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "../config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "piano_private.h"
+
+/* first allocation, enough for most requests */
+#define PIANO_JSON_WRITER_MIN 512
+
+/*	make room for size more bytes plus NUL
+ *	@return false if out of memory, the writer is marked failed then
+ */
+static bool PianoJsonReserve (PianoJsonWriter_t * const w, const size_t size) {
+	if (w->failed) {
+		return false;
+	}
+
+	if (w->length + size + 1 > w->capacity) {
+		size_t capacity = w->capacity > 0 ? w->capacity :
+				PIANO_JSON_WRITER_MIN;
+		while (w->length + size + 1 > capacity) {
+			capacity *= 2;
+		}
+
+		char * const buf = realloc (w->buf, capacity);
+		if (buf == NULL) {
+			w->failed = true;
+			return false;
+		}
+		w->buf = buf;
+		w->capacity = capacity;
+	}
+
+	return true;
+}
+
+static void PianoJsonPut (PianoJsonWriter_t * const w, const char * const s,
+		const size_t size) {
+	if (PianoJsonReserve (w, size)) {
+		memcpy (&w->buf[w->length], s, size);
+		w->length += size;
+		w->buf[w->length] = '\0';
+	}
+}
+
+/*	quoted and escaped string
+ */
+static void PianoJsonPutString (PianoJsonWriter_t * const w,
+		const char * const s) {
+	static const char hex[] = "0123456789abcdef";
+	const char *run = s, *c;
+
+	PianoJsonPut (w, "\"", 1);
+	for (c = s; *c != '\0'; c++) {
+		const unsigned char ch = (unsigned char) *c;
+		char esc[6] = {'\\', 0, 0, 0, 0, 0};
+		size_t escSize = 2;
+
+		if (ch >= 0x20 && ch != '"' && ch != '\\') {
+			/* copied in runs, utf-8 passes through */
+			continue;
+		}
+
+		switch (ch) {
+			case '"': esc[1] = '"'; break;
+			case '\\': esc[1] = '\\'; break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default:
+				esc[1] = 'u';
+				esc[2] = esc[3] = '0';
+				esc[4] = hex[ch >> 4];
+				esc[5] = hex[ch & 0xf];
+				escSize = 6;
+				break;
+		}
+
+		PianoJsonPut (w, run, (size_t) (c - run));
+		PianoJsonPut (w, esc, escSize);
+		run = c + 1;
+	}
+	PianoJsonPut (w, run, (size_t) (c - run));
+	PianoJsonPut (w, "\"", 1);
+}
+
+/*	separator and key of the next value
+ *	@param key, NULL inside arrays and at top level
+ */
+static void PianoJsonPutKey (PianoJsonWriter_t * const w,
+		const char * const key) {
+	if (w->comma) {
+		PianoJsonPut (w, ",", 1);
+	}
+	if (key != NULL) {
+		PianoJsonPutString (w, key);
+		PianoJsonPut (w, ":", 1);
+	}
+	w->comma = true;
+}
+
+/*	start new document, keeps the buffer
+ */
+void PianoJsonWriterReset (PianoJsonWriter_t * const w) {
+	w->length = 0;
+	w->comma = false;
+	w->failed = false;
+	if (w->buf != NULL) {
+		w->buf[0] = '\0';
+	}
+}
+
+void PianoJsonWriterDestroy (PianoJsonWriter_t * const w) {
+	free (w->buf);
+	memset (w, 0, sizeof (*w));
+}
+
+void PianoJsonBeginObject (PianoJsonWriter_t * const w,
+		const char * const key) {
+	PianoJsonPutKey (w, key);
+	PianoJsonPut (w, "{", 1);
+	w->comma = false;
+}
+
+void PianoJsonEndObject (PianoJsonWriter_t * const w) {
+	PianoJsonPut (w, "}", 1);
+	w->comma = true;
+}
+
+void PianoJsonBeginArray (PianoJsonWriter_t * const w,
+		const char * const key) {
+	PianoJsonPutKey (w, key);
+	PianoJsonPut (w, "[", 1);
+	w->comma = false;
+}
+
+void PianoJsonEndArray (PianoJsonWriter_t * const w) {
+	PianoJsonPut (w, "]", 1);
+	w->comma = true;
+}
+
+/*	add string member, or array element if key is NULL
+ *	@param writer
+ *	@param key
+ *	@param value, NULL is written as null
+ */
+void PianoJsonAddString (PianoJsonWriter_t * const w, const char * const key,
+		const char * const value) {
+	PianoJsonPutKey (w, key);
+	if (value == NULL) {
+		PianoJsonPut (w, "null", 4);
+	} else {
+		PianoJsonPutString (w, value);
+	}
+}
+
+void PianoJsonAddBool (PianoJsonWriter_t * const w, const char * const key,
+		const bool value) {
+	PianoJsonPutKey (w, key);
+	if (value) {
+		PianoJsonPut (w, "true", 4);
+	} else {
+		PianoJsonPut (w, "false", 5);
+	}
+}
+
+void PianoJsonAddInt (PianoJsonWriter_t * const w, const char * const key,
+		const int64_t value) {
+	/* digits backwards, enough for INT64_MIN */
+	char digits[20], *d = &digits[sizeof (digits)];
+	uint64_t v = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+
+	do {
+		*--d = (char) ('0' + v % 10);
+		v /= 10;
+	} while (v > 0);
+	if (value < 0) {
+		*--d = '-';
+	}
+
+	PianoJsonPutKey (w, key);
+	PianoJsonPut (w, d, (size_t) (&digits[sizeof (digits)] - d));
+}
@@ -168,7 +168,7 @@ static bool BarMainGetStations(BarApp_t *app)
 static void BarMainGetInitialStation (BarApp_t *app) {
 	/* try to get autostart station */
 	if (app->settings.autostartStation != NULL) {
-		app->nextStation = PianoFindStationById (app->ph.stations,
+		app->nextStation = PianoGetStationById (&app->ph,
 				app->settings.autostartStation);
 		if (app->nextStation == NULL) {
 			BarUiMsg (&app->settings, MSG_ERR,
@@ -223,8 +223,10 @@ static void BarMainHandleUserInput(BarApp_t *app)
 
     BarReadlineSetVirtualKeyHandler(app->rl, BarMainHandleVirtualKey, app);
 
+    /* wake up more often while requests are running in background */
     readSize = BarReadline(buf, sizeof(buf), NULL, app->rl,
-        BAR_RL_FULLRETURN | BAR_RL_NOECHO, 1000);
+        BAR_RL_FULLRETURN | BAR_RL_NOECHO,
+        HttpPending(app->http2) > 0 ? 100 : 1000);
 
     BarReadlineSetVirtualKeyHandler(app->rl, NULL, NULL);
 
@@ -264,6 +266,50 @@ static void BarMainGetPlaylist (BarApp_t *app) {
 			pRet);
 }
 
+/*	background playlist request is done, append songs if they still belong
+ *	to the station we are going to play
+ */
+static void BarMainPrefetchPlaylistDone (BarApp_t *app,
+		PianoRequestType_t type, void *data, PianoReturn_t pRet,
+		void *userData) {
+	PianoRequestDataGetPlaylist_t * const reqData = data;
+
+	app->prefetching = false;
+
+	if (pRet != PIANO_RET_OK || reqData->retPlaylist == NULL) {
+		/* BarMainGetPlaylist will try again once the playlist runs dry */
+		return;
+	}
+
+	if (reqData->station != app->nextStation) {
+		/* user switched stations in the meantime */
+		PianoDestroyPlaylist (reqData->retPlaylist);
+	} else {
+		app->playlist = PianoListAppendP (app->playlist, reqData->retPlaylist);
+		BarUiStartEventCmd (&app->settings, "stationfetchplaylist",
+				app->curStation, app->playlist, &app->player, app->ph.stations,
+				pRet);
+	}
+	reqData->retPlaylist = NULL;
+}
+
+/*	request next playlist while the last song of the current one is playing
+ */
+static void BarMainPrefetchPlaylist (BarApp_t *app) {
+	if (app->prefetching || app->nextStation == NULL ||
+			app->nextStation != app->curStation) {
+		return;
+	}
+
+	app->prefetch.station = app->nextStation;
+	app->prefetch.quality = app->settings.audioQuality;
+	app->prefetch.retPlaylist = NULL;
+	app->prefetching = true;
+
+	BarUiPianoCallAsync (app, NULL, PIANO_REQUEST_GET_PLAYLIST,
+			&app->prefetch, BarMainPrefetchPlaylistDone, NULL);
+}
+
 /*	start new player thread
  */
 static void BarMainStartPlayback(BarApp_t *app)
@@ -274,7 +320,7 @@ static void BarMainStartPlayback(BarApp_t *app)
     assert(curSong != NULL);
 
     BarUiPrintSong(&app->settings, curSong, app->curStation->isQuickMix ?
-        PianoFindStationById(app->ph.stations,
+        PianoGetStationById(&app->ph,
             curSong->stationId) : NULL);
 
     static const char httpPrefix[] = "http://";
@@ -394,6 +440,11 @@ static void BarMainLoop(BarApp_t *app)
                 app->playlist = PianoListNextP(app->playlist);
                 histsong->head.next = NULL;
                 BarUiHistoryPrepend(app, histsong);
+            }
+            /* background fetch may be just about to deliver */
+            if (app->playlist == NULL && app->prefetching)
+            {
+                BarUiPianoCallFlush(app);
             }
 			if (app->playlist == NULL && app->nextStation != NULL && !app->doQuit)
 			{
@@ -407,11 +458,19 @@ static void BarMainLoop(BarApp_t *app)
             if (app->playlist != NULL)
             {
                 BarMainStartPlayback(app);
+
+                if (PianoListNextP(app->playlist) == NULL)
+                {
+                    BarMainPrefetchPlaylist(app);
+                }
             }
         }
 
         BarMainHandleUserInput(app);
 
+        /* finish requests running in background */
+        BarUiPianoCallPoll(app);
+
         /* show time */
         if (BarPlayer2IsPlaying(app->player) || BarPlayer2IsPaused(app->player))
         {
@@ -471,23 +530,65 @@ int main(int argc, char **argv)
             app.settings.keys[BAR_KS_HELP]);
     }
 
-    HttpInit(&app.http2, app.settings.rpcHost, app.settings.rpcTlsPort,
-        app.settings.timeout);
+    if (app.settings.httpReplay)
+    {
+        if (!HttpInitReplay(&app.http2, app.settings.httpReplay,
+            app.settings.httpReplayLatency))
+        {
+            BarUiMsg(&app.settings, MSG_ERR, "Cannot replay http requests from \"%s\".\n", app.settings.httpReplay);
+            return 0;
+        }
+    }
+    else if (!HttpInit(&app.http2, app.settings.httpBackend, app.settings.rpcHost,
+        app.settings.rpcTlsPort, app.settings.timeout))
+    {
+        if (app.settings.httpBackend)
+            BarUiMsg(&app.settings, MSG_ERR, "Http backend \"%s\" initialization failed.\n", app.settings.httpBackend);
+        else
+            BarUiMsg(&app.settings, MSG_ERR, "Http initialization failed.\n");
+        return 0;
+    }
     if (app.settings.controlProxy)
         HttpSetProxy(app.http2, app.settings.controlProxy);
 
+    HttpRetryPolicy_t retryPolicy;
+    HttpRetryPolicyDefault(&retryPolicy);
+    retryPolicy.defaultAttempts = app.settings.httpRetries + 1;
+    retryPolicy.baseDelay = app.settings.httpRetryDelay;
+    retryPolicy.maxDelay = app.settings.httpRetryMaxDelay;
+    retryPolicy.breakerThreshold = app.settings.httpBreakerThreshold;
+    retryPolicy.breakerCooldown = app.settings.httpBreakerCooldown * 1000;
+    HttpSetRetryPolicy(app.http2, &retryPolicy);
+    HttpSetCompression(app.http2, app.settings.httpCompression);
+    HttpSetCacheTtl(app.http2, app.settings.httpCacheTtl * 1000);
+    if (app.settings.httpRecord &&
+        !HttpSetRecordFile(app.http2, app.settings.httpRecord))
+        BarUiMsg(&app.settings, MSG_ERR, "Cannot record http requests to \"%s\".\n", app.settings.httpRecord);
+
 
     BarReadlineInit(&app.rl);
 
     BarMainLoop(&app);
 
+    /* let background requests complete before tearing things down */
+    BarUiPianoCallFlush(&app);
+
+    if (app.settings.httpStatsFile)
+    {
+        FILE* statsFile = fopen(app.settings.httpStatsFile, "w");
+        if (!statsFile || !HttpDumpStats(app.http2, statsFile))
+            BarUiMsg(&app.settings, MSG_ERR, "Cannot write http statistics to \"%s\".\n", app.settings.httpStatsFile);
+        if (statsFile)
+            fclose(statsFile);
+    }
+
     BarReadlineDestroy(app.rl);
 
     /* write statefile */
     BarSettingsWrite(app.curStation, &app.settings);
 
     PianoDestroy(&app.ph);
-    PianoDestroyPlaylist(app.songHistory);
+    BarUiHistoryDestroy(&app);
     PianoDestroyPlaylist(app.playlist);
     HttpDestroy(app.http2);
     BarPlayer2Destroy(app.player);
@@ -32,6 +32,14 @@ THE SOFTWARE.
 #include "settings.h"
 #include "ui_readline.h"
 
+/* last played songs, fixed capacity ring; the songs are linked newest to
+ * oldest as well, so the newest one can be used as a regular list */
+typedef struct {
+	PianoSong_t **songs;
+	/* capacity is settings.history, newest is the index of the latest song */
+	size_t capacity, count, newest;
+} BarSongHistory_t;
+
 typedef struct {
 	PianoHandle_t ph;
 	//CURL *http;
@@ -40,12 +48,20 @@ typedef struct {
 	BarSettings_t settings;
 	/* first item is current song */
 	PianoSong_t *playlist;
-	PianoSong_t *songHistory;
+	BarSongHistory_t songHistory;
 	/* station of current song and station used to fetch songs from if playlist
 	 * is empty */
 	PianoStation_t *curStation, *nextStation;
 	char doQuit;
 	BarReadline_t rl;
 	unsigned int retries;
+	/* next playlist, requested in background while last song plays */
+	PianoRequestDataGetPlaylist_t prefetch;
+	bool prefetching;
+	/* async calls that got an invalid auth token, retried after logging in
+	 * again from BarUiPianoCallPoll; not from the http callback, which
+	 * would have to wait for http requests inside HttpPoll */
+	struct BarUiAsyncCall *reauthCalls;
+	bool reauthenticating;
 } BarApp_t;
 
@@ -154,6 +154,10 @@ void BarSettingsDestroy (BarSettings_t *settings) {
 	free (settings->timeFormat);
 	free (settings->titleFormat);
 	free (settings->player);
+	free (settings->httpBackend);
+	free (settings->httpRecord);
+	free (settings->httpReplay);
+	free (settings->httpStatsFile);
 	free (settings->fifo);
 	free (settings->rpcHost);
 	free (settings->rpcTlsPort);
@@ -189,6 +193,15 @@ void BarSettingsRead (BarSettings_t *settings) {
 	settings->history = 5;
 	settings->volume = 0;
 	settings->timeout = 30; /* seconds */
+	/* keep in sync with HttpRetryPolicyDefault */
+	settings->httpRetries = 2;
+	settings->httpRetryDelay = 250; /* milliseconds */
+	settings->httpRetryMaxDelay = 8000;
+	settings->httpBreakerThreshold = 6;
+	settings->httpBreakerCooldown = 30; /* seconds */
+	settings->httpCompression = true;
+	settings->httpCacheTtl = 30; /* seconds */
+	settings->httpReplayLatency = -1; /* as recorded */
 	settings->gainMul = 1.0;
 	/* should be > 4, otherwise expired audio urls (403) can stop playback */
 	settings->maxRetry = 5;
@@ -392,6 +405,20 @@ void BarSettingsRead (BarSettings_t *settings) {
 				settings->maxRetry = atoi (val);
 			} else if (streq ("timeout", key)) {
 				settings->timeout = atoi (val);
+			} else if (streq ("http_retries", key)) {
+				settings->httpRetries = atoi (val);
+			} else if (streq ("http_retry_delay", key)) {
+				settings->httpRetryDelay = atoi (val);
+			} else if (streq ("http_retry_max_delay", key)) {
+				settings->httpRetryMaxDelay = atoi (val);
+			} else if (streq ("http_breaker_threshold", key)) {
+				settings->httpBreakerThreshold = atoi (val);
+			} else if (streq ("http_breaker_cooldown", key)) {
+				settings->httpBreakerCooldown = atoi (val);
+			} else if (streq ("http_cache_ttl", key)) {
+				settings->httpCacheTtl = atoi (val);
+			} else if (streq ("http_compression", key)) {
+				settings->httpCompression = atoi (val);
 			} else if (streq ("sort", key)) {
 				size_t i;
 				static const char *mapping[] = {"name_az",
@@ -441,6 +468,20 @@ void BarSettingsRead (BarSettings_t *settings) {
 			} else if (streq ("player", key)) {
 				free (settings->player);
 				settings->player = strdup (val);
+			} else if (streq ("http_backend", key)) {
+				free (settings->httpBackend);
+				settings->httpBackend = strdup (val);
+			} else if (streq ("http_record", key)) {
+				free (settings->httpRecord);
+				settings->httpRecord = strdup (val);
+			} else if (streq ("http_replay", key)) {
+				free (settings->httpReplay);
+				settings->httpReplay = strdup (val);
+			} else if (streq ("http_replay_latency", key)) {
+				settings->httpReplayLatency = atoi (val);
+			} else if (streq ("http_stats_file", key)) {
+				free (settings->httpStatsFile);
+				settings->httpStatsFile = strdup (val);
 			} else if (streq ("fifo", key)) {
 				free (settings->fifo);
 				settings->fifo = BarSettingsExpandTilde (val, userhome);
@@ -85,9 +85,11 @@ typedef struct {
 #include "ui_types.h"
 
 typedef struct {
-	bool autoselect;
+	bool autoselect, httpCompression;
 	unsigned int history, maxRetry, timeout;
-	int volume;
+	unsigned int httpRetries, httpRetryDelay, httpRetryMaxDelay;
+	unsigned int httpBreakerThreshold, httpBreakerCooldown, httpCacheTtl;
+	int volume, httpReplayLatency;
 	float gainMul;
 	BarStationSorting_t sortOrder;
 	PianoAudioQuality_t audioQuality;
@@ -106,6 +108,7 @@ typedef struct {
 	char *timeFormat;
 	char *titleFormat;
 	char *player;
+	char *httpBackend, *httpRecord, *httpReplay, *httpStatsFile;
 	char *fifo;
 	char *rpcHost, *rpcTlsPort, *partnerUser, *partnerPassword, *device, *inkey, *outkey, *caBundle;
 	char keys[BAR_KS_COUNT];
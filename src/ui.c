@@ -156,10 +156,13 @@ void BarUiMsg (const BarSettings_t *settings, const BarUiMsg_t type,
 int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 		void *data, PianoReturn_t *pRet) {
 	PianoRequest_t req;
-	int netErrorRetries = 3;
 
 	memset (&req, 0, sizeof (req));
 
+	/* keep requests in order and make sure no callback runs after this call
+	 * changed data structures under its feet */
+	BarUiPianoCallFlush (app);
+
 	/* repeat as long as there are http requests to do */
 	do {
 		req.data = data;
@@ -171,19 +174,12 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 			return 0;
 		}
 
+		/* transient errors are retried by the http layer already, see
+		 * HttpRetryPolicy_t */
 		if (!HttpRequest(app->http2, &req)) {
 			*pRet = PIANO_RET_NETWORK_ERROR;
 			BarUiMsg(&app->settings, MSG_ERR, "Network error: %s\n",
 				HttpGetError(app->http2));
-			if (req.responseData != NULL) {
-				free(req.responseData);
-			}
-			if (--netErrorRetries > 0) {
-				/* try again */
-				*pRet = PIANO_RET_CONTINUE_REQUEST;
-				BarUiMsg (&app->settings, MSG_INFO, "Trying again... ");
-				continue;
-			}
 			PianoDestroyRequest(&req);
 			return 0;
 		}
@@ -203,9 +199,6 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 				BarUiMsg (&app->settings, MSG_NONE, "Reauthentication required... ");
 				if (!BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData, &authpRet)) {
 					*pRet = authpRet;
-					if (req.responseData != NULL) {
-						free (req.responseData);
-					}
 					PianoDestroyRequest (&req);
 					return 0;
 				} else {
@@ -215,9 +208,6 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 				}
 			} else if (*pRet != PIANO_RET_OK) {
 				BarUiMsg (&app->settings, MSG_NONE, "Error: %s\n", PianoErrorToStr (*pRet));
-				if (req.responseData != NULL) {
-					free (req.responseData);
-				}
 				PianoDestroyRequest (&req);
 				return 0;
 			} else {
@@ -226,16 +216,225 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 		}
 		/* we can destroy the request at this point, even when this call needs
 		 * more than one http request. persistent data (step counter, e.g.) is
-		 * stored in req.data */
-		if (req.responseData != NULL) {
-			free (req.responseData);
-		}
+		 * stored in req.data. responseData belongs to the http handle and is
+		 * reused by the next request */
 		PianoDestroyRequest (&req);
 	} while (*pRet == PIANO_RET_CONTINUE_REQUEST);
 
 	return 1;
 }
 
+/* piano call in flight, see BarUiPianoCallAsync */
+typedef struct BarUiAsyncCall {
+	struct BarUiAsyncCall *next;
+	BarApp_t *app;
+	const char *label;
+	PianoRequestType_t type;
+	void *data;
+	PianoRequest_t req;
+	bool reauthenticated;
+	BarUiPianoCallback_t callback;
+	void *userData;
+} BarUiAsyncCall_t;
+
+static void BarUiPianoCallAsyncDone (http_t, PianoRequest_t *, bool,
+		const char *, void *);
+
+/*	report result of async call and get rid of it
+ *	@param call
+ *	@param result
+ *	@param network error message or NULL
+ */
+static void BarUiPianoCallAsyncFinish (BarUiAsyncCall_t *call,
+		PianoReturn_t pRet, const char *netError) {
+	BarApp_t * const app = call->app;
+	const char * const label = call->label != NULL ? call->label : "Request";
+
+	if (pRet == PIANO_RET_NETWORK_ERROR) {
+		BarUiMsg (&app->settings, MSG_ERR, "%s... Network error: %s\n",
+				label, netError != NULL ? netError : "unknown");
+	} else if (pRet != PIANO_RET_OK) {
+		BarUiMsg (&app->settings, MSG_INFO, "%s... Error: %s\n", label,
+				PianoErrorToStr (pRet));
+	} else if (call->label != NULL) {
+		BarUiMsg (&app->settings, MSG_INFO, "%s... Ok.\n", call->label);
+	}
+
+	PianoDestroyRequest (&call->req);
+	if (call->callback != NULL) {
+		call->callback (app, call->type, call->data, pRet, call->userData);
+	}
+	free (call);
+}
+
+/*	build next http request of call and hand it to the http worker
+ */
+static void BarUiPianoCallAsyncSubmit (BarUiAsyncCall_t *call) {
+	BarApp_t * const app = call->app;
+	PianoReturn_t pRet;
+
+	PianoDestroyRequest (&call->req);
+	call->req.data = call->data;
+
+	if ((pRet = PianoRequest (&app->ph, &call->req, call->type)) !=
+			PIANO_RET_OK) {
+		BarUiPianoCallAsyncFinish (call, pRet, NULL);
+		return;
+	}
+
+	if (!HttpRequestAsync (app->http2, &call->req, BarUiPianoCallAsyncDone,
+			call)) {
+		BarUiPianoCallAsyncFinish (call, PIANO_RET_OUT_OF_MEMORY, NULL);
+	}
+}
+
+/*	http completion, runs on main thread from HttpPoll
+ */
+static void BarUiPianoCallAsyncDone (http_t http, PianoRequest_t *req,
+		bool succeeded, const char *error, void *userData) {
+	BarUiAsyncCall_t * const call = userData;
+	BarApp_t * const app = call->app;
+	PianoReturn_t pRet;
+
+	(void) http;
+
+	if (!succeeded) {
+		BarUiPianoCallAsyncFinish (call, PIANO_RET_NETWORK_ERROR, error);
+		return;
+	}
+
+	pRet = PianoResponse (&app->ph, req);
+	if (pRet == PIANO_RET_CONTINUE_REQUEST) {
+		BarUiPianoCallAsyncSubmit (call);
+	} else if (pRet == PIANO_RET_P_INVALID_AUTH_TOKEN &&
+			call->type != PIANO_REQUEST_LOGIN && !call->reauthenticated) {
+		/* logging in waits for http requests, not possible from here */
+		BarUiAsyncCall_t **tail = &app->reauthCalls;
+		while (*tail != NULL) {
+			tail = &(*tail)->next;
+		}
+		call->next = NULL;
+		*tail = call;
+	} else {
+		BarUiPianoCallAsyncFinish (call, pRet, NULL);
+	}
+}
+
+/*	log in again for async calls that got an invalid auth token and resubmit
+ *	them, one login serves all of them
+ *	@return true if calls were resubmitted
+ */
+static bool BarUiPianoCallReauth (BarApp_t * const app) {
+	bool resubmitted = false;
+
+	/* calls failing while logging in are picked up by the loop below */
+	if (app->reauthenticating) {
+		return false;
+	}
+
+	app->reauthenticating = true;
+	while (app->reauthCalls != NULL) {
+		BarUiAsyncCall_t *calls = app->reauthCalls, *call;
+		PianoReturn_t authpRet;
+		PianoRequestDataLogin_t reqData;
+		bool loggedIn;
+
+		app->reauthCalls = NULL;
+
+		reqData.user = app->settings.username;
+		reqData.password = app->settings.password;
+		reqData.step = 0;
+
+		BarUiMsg (&app->settings, MSG_NONE, "Reauthentication required... ");
+		loggedIn = BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData,
+				&authpRet);
+
+		while ((call = calls) != NULL) {
+			calls = call->next;
+			call->next = NULL;
+			if (loggedIn) {
+				call->reauthenticated = true;
+				BarUiPianoCallAsyncSubmit (call);
+				resubmitted = true;
+			} else {
+				BarUiPianoCallAsyncFinish (call, authpRet, NULL);
+			}
+		}
+	}
+	app->reauthenticating = false;
+
+	return resubmitted;
+}
+
+/*	non-blocking variant of BarUiPianoCall, the http round-trip happens in
+ *	the background while libpiano is only touched from the main loop (see
+ *	BarUiPianoCallPoll)
+ *	@param app handle
+ *	@param message printed along with the result, NULL to stay quiet
+ *		unless the call failed
+ *	@param request type
+ *	@param request data, must stay valid until callback is called
+ *	@param called exactly once when the call is done, may be NULL
+ *	@param passed to callback
+ */
+void BarUiPianoCallAsync (BarApp_t * const app, const char *label,
+		PianoRequestType_t type, void *data, BarUiPianoCallback_t callback,
+		void *userData) {
+	BarUiAsyncCall_t *call;
+
+	assert (app != NULL);
+
+	if ((call = calloc (1, sizeof (*call))) == NULL) {
+		BarUiMsg (&app->settings, MSG_ERR, "Error: %s\n",
+				PianoErrorToStr (PIANO_RET_OUT_OF_MEMORY));
+		if (callback != NULL) {
+			callback (app, type, data, PIANO_RET_OUT_OF_MEMORY, userData);
+		}
+		return;
+	}
+
+	call->app = app;
+	call->label = label;
+	call->type = type;
+	call->data = data;
+	call->callback = callback;
+	call->userData = userData;
+
+	BarUiPianoCallAsyncSubmit (call);
+}
+
+/*	start group of independent async calls, their first http requests go
+ *	out together when BarUiPianoCallBatchEnd is called
+ */
+void BarUiPianoCallBatchBegin (BarApp_t * const app) {
+	HttpBatchBegin (app->http2);
+}
+
+/*	send async calls made since BarUiPianoCallBatchBegin
+ */
+void BarUiPianoCallBatchEnd (BarApp_t * const app) {
+	HttpBatchEnd (app->http2);
+}
+
+/*	run callbacks of finished async calls
+ *	@return number of http requests completed
+ */
+size_t BarUiPianoCallPoll (BarApp_t * const app) {
+	const size_t completed = HttpPoll (app->http2);
+
+	BarUiPianoCallReauth (app);
+
+	return completed;
+}
+
+/*	wait for all async calls to finish
+ */
+void BarUiPianoCallFlush (BarApp_t * const app) {
+	do {
+		HttpWait (app->http2);
+	} while (BarUiPianoCallReauth (app));
+}
+
 /*	Station sorting functions */
 
 static inline int BarStationQuickmix01Cmp (const void *a, const void *b) {
@@ -684,7 +883,7 @@ size_t BarUiListSongs (const BarApp_t * const app,
 			const char *stationName = empty;
 
 			const PianoStation_t * const station =
-					PianoFindStationById (app->ph.stations, song->stationId);
+					PianoGetStationById (&app->ph, song->stationId);
 			if (station != NULL && station != app->curStation) {
 				stationName = station->name;
 			} else if (station == NULL && song->stationId != NULL) {
@@ -827,28 +1026,71 @@ void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 	//}
 }
 
-/*	prepend song to history
+/*	get song from history
+ *	@param app handle
+ *	@param 0 for the latest song
+ *	@return song or NULL if the history is shorter
+ */
+PianoSong_t *BarUiHistoryGet (const BarApp_t * const app, const size_t n) {
+	const BarSongHistory_t * const history = &app->songHistory;
+
+	if (n >= history->count) {
+		return NULL;
+	}
+	return history->songs[(history->newest + history->capacity - n) %
+			history->capacity];
+}
+
+/*	prepend song to history, evicts the oldest one if it is full
  */
 void BarUiHistoryPrepend (BarApp_t *app, PianoSong_t *song) {
+	BarSongHistory_t * const history = &app->songHistory;
+
 	assert (app != NULL);
 	assert (song != NULL);
 	/* make sure it's a single song */
 	assert (PianoListNextP (song) == NULL);
 
-	if (app->settings.history != 0) {
-		app->songHistory = PianoListPrependP (app->songHistory, song);
-		PianoSong_t *del;
-		do {
-			del = PianoListGetP (app->songHistory, app->settings.history);
-			if (del != NULL) {
-				app->songHistory = PianoListDeleteP (app->songHistory, del);
-				PianoDestroyPlaylist (del);
-			} else {
-				break;
-			}
-		} while (true);
-	} else {
+	if (history->songs == NULL && app->settings.history != 0) {
+		/* history length is fixed once settings are read */
+		history->songs = calloc (app->settings.history,
+				sizeof (*history->songs));
+		history->capacity = history->songs != NULL ?
+				app->settings.history : 0;
+	}
+
+	if (history->capacity == 0) {
+		BarUiPianoCallFlush (app);
 		PianoDestroyPlaylist (song);
+		return;
+	}
+
+	if (history->count == history->capacity) {
+		PianoSong_t * const oldest = BarUiHistoryGet (app, history->count - 1);
+		if (history->count > 1) {
+			/* unlink from second oldest */
+			BarUiHistoryGet (app, history->count - 2)->head.next = NULL;
+		}
+		--history->count;
+		/* pending calls may still refer to it */
+		BarUiPianoCallFlush (app);
+		PianoDestroyPlaylist (oldest);
 	}
+
+	song = PianoListPrependP (BarUiHistoryGet (app, 0), song);
+	history->newest = (history->newest + 1) % history->capacity;
+	history->songs[history->newest] = song;
+	++history->count;
+}
+
+/*	free history and its songs
+ */
+void BarUiHistoryDestroy (BarApp_t * const app) {
+	BarSongHistory_t * const history = &app->songHistory;
+
+	/* songs are linked, newest first */
+	PianoDestroyPlaylist (BarUiHistoryGet (app, 0));
+	free (history->songs);
+	memset (history, 0, sizeof (*history));
 }
 
@@ -34,6 +34,8 @@ THE SOFTWARE.
 #include "ui_types.h"
 
 typedef void (*BarUiSelectStationCallback_t) (BarApp_t *app, char *buf);
+typedef void (*BarUiPianoCallback_t) (BarApp_t *app, PianoRequestType_t type,
+		void *data, PianoReturn_t pRet, void *userData);
 
 void BarUiMsg (const BarSettings_t *, const BarUiMsg_t, const char *, ...) __attribute__((format(printf, 3, 4)));
 PianoStation_t *BarUiSelectStation (BarApp_t *, PianoStation_t *, const char *,
@@ -52,7 +54,15 @@ void BarUiStartEventCmd (const BarSettings_t *, const char *,
 		PianoStation_t *, PianoReturn_t);
 int BarUiPianoCall (BarApp_t * const, PianoRequestType_t,
 		void *, PianoReturn_t *);
+void BarUiPianoCallAsync (BarApp_t * const, const char *, PianoRequestType_t,
+		void *, BarUiPianoCallback_t, void *);
+void BarUiPianoCallBatchBegin (BarApp_t * const);
+void BarUiPianoCallBatchEnd (BarApp_t * const);
+size_t BarUiPianoCallPoll (BarApp_t * const);
+void BarUiPianoCallFlush (BarApp_t * const);
 void BarUiHistoryPrepend (BarApp_t *app, PianoSong_t *song);
+PianoSong_t *BarUiHistoryGet (const BarApp_t * const, const size_t);
+void BarUiHistoryDestroy (BarApp_t * const);
 void BarUiCustomFormat (char *dest, size_t destSize, const char *format,
 		const char *formatChars, const char **formatVals);
 
@@ -45,6 +45,44 @@ THE SOFTWARE.
 #define BarUiActDefaultPianoCall(call, arg) BarUiPianoCall (app, \
 		call, arg, &pRet)
 
+/*	song action running in background, see BarUiActAsyncSongDone
+ */
+typedef struct {
+	PianoRequestDataRateSong_t rate;
+	const char *event;
+	PianoStation_t *station;
+	PianoSong_t *song;
+} BarUiActAsyncSong_t;
+
+/*	standard eventcmd for finished background song action
+ */
+static void BarUiActAsyncSongDone (BarApp_t *app, PianoRequestType_t type,
+		void *data, PianoReturn_t pRet, void *userData) {
+	BarUiActAsyncSong_t * const ctx = userData;
+
+	BarUiStartEventCmd (&app->settings, ctx->event, ctx->station, ctx->song,
+			&app->player, app->ph.stations, pRet);
+	free (ctx);
+}
+
+/*	queue song action, eventcmd fires when it is done
+ *	@return context, NULL if out of memory
+ */
+static BarUiActAsyncSong_t *BarUiActAsyncSongNew (BarApp_t *app,
+		const char *event, PianoStation_t *station, PianoSong_t *song) {
+	BarUiActAsyncSong_t * const ctx = calloc (1, sizeof (*ctx));
+
+	if (ctx == NULL) {
+		BarUiMsg (&app->settings, MSG_ERR, "Error: %s\n",
+				PianoErrorToStr (PIANO_RET_OUT_OF_MEMORY));
+		return NULL;
+	}
+	ctx->event = event;
+	ctx->station = station;
+	ctx->song = song;
+	return ctx;
+}
+
 /*	helper to _really_ skip a song (unlock mutex, quit player)
  *	@param player handle
  */
@@ -124,7 +162,7 @@ BarUiActCallback(BarUiActBanSong) {
 	assert (selSong != NULL);
 	assert (selSong->stationId != NULL);
 
-	if ((realStation = PianoFindStationById (app->ph.stations,
+	if ((realStation = PianoGetStationById (&app->ph,
 			selSong->stationId)) == NULL) {
 		assert (0);
 		return;
@@ -214,6 +252,7 @@ static void drainPlaylist (BarApp_t * const app) {
 	BarUiDoSkipSong (app->player);
 	if (app->playlist != NULL) {
 		/* drain playlist */
+		BarUiPianoCallFlush (app);
 		PianoDestroyPlaylist (PianoListNextP (app->playlist));
 		app->playlist->head.next = NULL;
 	}
@@ -333,7 +372,7 @@ BarUiActCallback(BarUiActSongInfo) {
 	/* print real station if quickmix */
 	BarUiPrintSong (&app->settings, selSong,
 			selStation->isQuickMix ?
-			PianoFindStationById (app->ph.stations, selSong->stationId) :
+			PianoGetStationById (&app->ph, selSong->stationId) :
 			NULL);
 }
 
@@ -342,6 +381,8 @@ BarUiActCallback(BarUiActSongInfo) {
 BarUiActCallback(BarUiActDebug) {
 	assert (selSong != NULL);
 
+	char *httpStats = HttpFormatStats (app->http2);
+
 	/* print debug-alike infos */
 	BarUiMsg (&app->settings, MSG_DEBUG,
 			"album:\t%s\n"
@@ -355,7 +396,8 @@ BarUiActCallback(BarUiActDebug) {
 			"rating:\t%i\n"
 			"stationId:\t%s\n"
 			"title:\t%s\n"
-			"trackToken:\t%s\n",
+			"trackToken:\t%s\n"
+			"%s",
 			selSong->album,
 			selSong->artist,
 			selSong->audioFormat,
@@ -367,20 +409,21 @@ BarUiActCallback(BarUiActDebug) {
 			selSong->rating,
 			selSong->stationId,
 			selSong->title,
-			selSong->trackToken);
+			selSong->trackToken,
+			httpStats != NULL ? httpStats : "");
+	free (httpStats);
 }
 
 /*	rate current song
  */
 BarUiActCallback(BarUiActLoveSong) {
-	PianoReturn_t pRet;
 	PianoStation_t *realStation;
 
 	assert (selStation != NULL);
 	assert (selSong != NULL);
 	assert (selSong->stationId != NULL);
 
-	if ((realStation = PianoFindStationById (app->ph.stations,
+	if ((realStation = PianoGetStationById (&app->ph,
 			selSong->stationId)) == NULL) {
 		assert (0);
 		return;
@@ -389,13 +432,17 @@ BarUiActCallback(BarUiActLoveSong) {
 		return;
 	}
 
-	PianoRequestDataRateSong_t reqData;
-	reqData.song = selSong;
-	reqData.rating = PIANO_RATE_LOVE;
+	BarUiActAsyncSong_t * const ctx = BarUiActAsyncSongNew (app, "songlove",
+			selStation, selSong);
+	if (ctx == NULL) {
+		return;
+	}
+	ctx->rate.song = selSong;
+	ctx->rate.rating = PIANO_RATE_LOVE;
 
-	BarUiMsg (&app->settings, MSG_INFO, "Loving song... ");
-	BarUiActDefaultPianoCall (PIANO_REQUEST_RATE_SONG, &reqData);
-	BarUiActDefaultEventcmd ("songlove");
+	/* nothing depends on the result, do not block playback */
+	BarUiPianoCallAsync (app, "Loving song", PIANO_REQUEST_RATE_SONG,
+			&ctx->rate, BarUiActAsyncSongDone, ctx);
 }
 
 /*	skip song
@@ -560,12 +607,12 @@ BarUiActCallback(BarUiActHistory) {
 	char buf[2];
 	PianoSong_t *histSong;
 
-	if (app->songHistory != NULL) {
-		histSong = BarUiSelectSong (app, app->songHistory,
+	if (app->songHistory.count > 0) {
+		histSong = BarUiSelectSong (app, BarUiHistoryGet (app, 0),
 				app->rl);
 		if (histSong != NULL) {
 			BarKeyShortcutId_t action;
-			PianoStation_t *songStation = PianoFindStationById (app->ph.stations,
+			PianoStation_t *songStation = PianoGetStationById (&app->ph,
 					histSong->stationId);
 
 			if (songStation == NULL) {
@@ -596,7 +643,7 @@ BarUiActCallback(BarUiActHistory) {
 /*	create song bookmark
  */
 BarUiActCallback(BarUiActBookmark) {
-	PianoReturn_t pRet;
+	BarUiActAsyncSong_t *ctx;
 	char selectBuf[2];
 
 	assert (selSong != NULL);
@@ -605,13 +652,19 @@ BarUiActCallback(BarUiActBookmark) {
 	BarReadline (selectBuf, sizeof (selectBuf), "sa", app->rl,
 			BAR_RL_FULLRETURN, -1);
 	if (selectBuf[0] == 's') {
-		BarUiMsg (&app->settings, MSG_INFO, "Bookmarking song... ");
-		BarUiActDefaultPianoCall (PIANO_REQUEST_BOOKMARK_SONG, selSong);
-		BarUiActDefaultEventcmd ("songbookmark");
+		if ((ctx = BarUiActAsyncSongNew (app, "songbookmark", selStation,
+				selSong)) != NULL) {
+			BarUiPianoCallAsync (app, "Bookmarking song",
+					PIANO_REQUEST_BOOKMARK_SONG, selSong, BarUiActAsyncSongDone,
+					ctx);
+		}
 	} else if (selectBuf[0] == 'a') {
-		BarUiMsg (&app->settings, MSG_INFO, "Bookmarking artist... ");
-		BarUiActDefaultPianoCall (PIANO_REQUEST_BOOKMARK_ARTIST, selSong);
-		BarUiActDefaultEventcmd ("artistbookmark");
+		if ((ctx = BarUiActAsyncSongNew (app, "artistbookmark", selStation,
+				selSong)) != NULL) {
+			BarUiPianoCallAsync (app, "Bookmarking artist",
+					PIANO_REQUEST_BOOKMARK_ARTIST, selSong, BarUiActAsyncSongDone,
+					ctx);
+		}
 	}
 }
 